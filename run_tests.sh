@@ -6,6 +6,9 @@ STUDENT_DIR="tests/solutions"
 # Directory containing the example files
 EXAMPLES_DIR="tests/examples"
 
+# Directory containing the command line of each option test
+OPTIONS_DIR="tests/options"
+
 # If $1 exists, append it to EXAMPLES_DIR
 if [ -n "$1" ]; then
     EXAMPLES_DIR="$EXAMPLES_DIR/$1"
@@ -13,18 +16,42 @@ fi
 
 # Iterate through each file in the directory
 for file in "$EXAMPLES_DIR"/*.soln; do
+  name=$(basename "$file" .soln)
   student_file="$STUDENT_DIR/$(basename "$file")"
 
+  # Compare only the last few lines of each file
+  lines=5
+
+  # Option tests run the emulator here: their .args file holds the archobj
+  # fed on stdin ("-" for none) and the flags, and the whole output is compared
+  if [[ -f "$OPTIONS_DIR/$name.args" ]]; then
+    read -r archobj flags < "$OPTIONS_DIR/$name.args"
+    mkdir -p "$STUDENT_DIR/options"
+    student_file="$STUDENT_DIR/options/$(basename "$file")"
+    if [[ "$archobj" == "-" ]]; then
+      ./src/r5emu $flags < /dev/null > "$student_file" 2>&1
+    else
+      ./src/r5emu $flags < "tests/archobjs/$archobj" > "$student_file" 2>&1
+    fi
+    lines=$(wc -l < "$file")
+  fi
+
   if [[ ! -f "$student_file" ]]; then
     echo "Missing an output for $(basename "$file")"
     continue
   fi
 
-  # Compare only the last few lines of each file
-  lines=5
   diff -w <(tail -n $lines "$file") <(tail -n $lines "$student_file") > /dev/null
   status=$?
 
+  # An option test whose flags write tests/solutions/options/<name>.file
+  # (plus any extension the option needs) also compares it
+  for out in "$EXAMPLES_DIR/$name".file*; do
+    [[ $status -eq 0 && -f "$out" ]] || continue
+    diff -w "$out" "$STUDENT_DIR/options/$(basename "$out")" > /dev/null
+    status=$?
+  done
+
   if [[ $status -eq 0 ]]; then
     echo "✅ PASSED: $(basename "$file") matches (last $lines lines)!"
   elif [[ $status -eq 1 ]]; then
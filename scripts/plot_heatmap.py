@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+
+# Plot the address x time heatmap written by `r5emu --heatmap=<file>`.
+#
+# Usage: plot_heatmap.py <heatmap.csv> [<out.png>] [--misses]
+#
+# Rows of the CSV are the non-zero cells, `interval,address,accesses,misses`.
+# Time runs left to right, and addresses bottom to top. Only the address
+# bins that were accessed get a row in the image, so a sparse address space
+# stays readable; the tick labels give their addresses. With `--misses`,
+# the misses are plotted instead of the accesses.
+
+import csv
+import sys
+
+import matplotlib
+matplotlib.use("Agg")
+import matplotlib.pyplot as plt
+import numpy as np
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith("--")]
+    if len(args) < 1:
+        print("Usage: plot_heatmap.py <heatmap.csv> [<out.png>] [--misses]")
+        sys.exit(1)
+    field = "misses" if "--misses" in sys.argv else "accesses"
+    out = args[1] if len(args) > 1 else args[0].rsplit(".", 1)[0] + ".png"
+
+    with open(args[0]) as f:
+        cells = [(int(r["interval"]), int(r["address"]), int(r[field])) for r in csv.DictReader(f)]
+    if not cells:
+        print("No accesses in " + args[0])
+        sys.exit(1)
+
+    times = sorted(set(c[0] for c in cells))
+    addrs = sorted(set(c[1] for c in cells))
+    col = {t: i for i, t in enumerate(times)}
+    row = {a: i for i, a in enumerate(addrs)}
+    grid = np.zeros((len(addrs), len(times)))
+    for t, a, n in cells:
+        grid[row[a], col[t]] += n
+
+    fig, ax = plt.subplots(figsize=(12, 6))
+    img = ax.imshow(grid, aspect="auto", origin="lower", interpolation="nearest", cmap="viridis")
+    fig.colorbar(img, ax=ax, label=field)
+    ax.set_xlabel("instructions")
+    ax.set_ylabel("address")
+    xt = np.linspace(0, len(times) - 1, min(len(times), 10)).astype(int)
+    yt = np.linspace(0, len(addrs) - 1, min(len(addrs), 16)).astype(int)
+    ax.set_xticks(xt)
+    ax.set_xticklabels([str(times[i]) for i in xt])
+    ax.set_yticks(yt)
+    ax.set_yticklabels([hex(addrs[i]) for i in yt])
+    ax.set_title(args[0] + " (" + field + ")")
+    fig.tight_layout()
+    fig.savefig(out)
+    print("Wrote " + out)
+
+if __name__ == "__main__":
+    main()
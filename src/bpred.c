@@ -0,0 +1,488 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bpred.h"
+
+// Initial number of per-branch statistics slots, a power of two
+#define BRANCH_STATS_INIT_SIZE 1024
+// Branches listed in the report
+#define BPRED_TOP_BRANCHES 10
+
+// TAGE's tagged tables, from the shortest history to the longest
+#define TAGE_TABLES 4
+#define TAGE_TAG_BITS 9
+// Branches between two halvings of the useful counters, so stale entries can be replaced
+#define TAGE_RESET_PERIOD (1UL << 18)
+
+static const unsigned int tage_history[TAGE_TABLES] = { 4, 8, 16, 32 };
+
+static const char *bpred_names[BPRED_COUNT] = { "static", "bimodal", "gshare", "tage", "btb", "ras" };
+
+struct tage_entry {
+	unsigned short tag;  // Tag + 1, 0 marks an empty entry
+	signed char ctr;     // 3-bit signed counter, taken if >= 0
+	unsigned char useful;
+};
+
+// Everything recorded about one branch or jump
+struct branch_stat {
+	unsigned long pc;
+	enum instruction_num inst_no;
+	unsigned long executed, taken;   // Free slots were never executed
+	unsigned long mispredicts[BPRED_COUNT];
+};
+
+struct bpred {
+	unsigned long types;                       // Bit t is set if predictor t is simulated
+	unsigned long index_bits, tage_bits;
+	unsigned char *bimodal, *gshare, *tage_base; // 2-bit counters, taken if >= 2
+	struct tage_entry *tage[TAGE_TABLES];
+	unsigned long tage_branches;
+	unsigned long history;                     // Outcomes of the last conditional branches, latest in bit 0
+	unsigned long btb_entries, *btb_pc, *btb_target; // Entries hold pc + 1, 0 if empty
+	unsigned long ras_entries, ras_top, ras_count, *ras;
+	unsigned long predictions[BPRED_COUNT], mispredicts[BPRED_COUNT];
+	int wrong[BPRED_COUNT];                    // The predictor got the last branch or jump wrong
+	unsigned long num_branches, num_taken, num_jumps, num_calls, num_returns;
+	struct branch_stat *stats;                 // Open addressing with linear probing
+	unsigned long stats_size, stats_count;
+};
+
+
+long bpred_parse(const char *list) {
+	long types = 0;
+
+	while (*list != '\0') {
+		size_t len = strcspn(list, ",");
+		int t;
+
+		for (t = 0; t < BPRED_COUNT; t++) {
+			if (strlen(bpred_names[t]) == len && strncmp(list, bpred_names[t], len) == 0) break;
+		}
+		if (t == BPRED_COUNT) return -1;
+		types |= 1L << t;
+		list += len;
+		if (*list == ',') list++;
+	}
+	return types;
+}
+
+
+static unsigned char *counters_alloc(unsigned long n) {
+	unsigned char *c = (unsigned char *)malloc(n);
+
+	// Weakly taken
+	if (c != NULL) memset(c, 2, n);
+	return c;
+}
+
+
+struct bpred *bpred_alloc(unsigned long types, unsigned long index_bits, unsigned long btb_entries, unsigned long ras_entries) {
+	unsigned long entries = 1UL << index_bits;
+	struct bpred *bp;
+	int failed = 0;
+
+	if (index_bits < 4 || index_bits > 28) {
+		fprintf(stderr, "Error: Branch predictor tables need between 4 and 28 index bits.\n");
+		return NULL;
+	}
+	if ((types & (1UL << BPRED_BTB)) && (btb_entries == 0 || (btb_entries & (btb_entries - 1)) != 0)) {
+		fprintf(stderr, "Error: The number of BTB entries must be a power of two.\n");
+		return NULL;
+	}
+	if ((types & (1UL << BPRED_RAS)) && ras_entries == 0) {
+		fprintf(stderr, "Error: The return-address stack needs at least one entry.\n");
+		return NULL;
+	}
+	bp = (struct bpred *)calloc(1, sizeof(struct bpred));
+	if (bp == NULL) {
+		perror("Failed to allocate branch predictors");
+		return NULL;
+	}
+	bp->types = types;
+	bp->index_bits = index_bits;
+	bp->tage_bits = index_bits - 2;
+	bp->btb_entries = btb_entries;
+	bp->ras_entries = ras_entries;
+	bp->stats_size = BRANCH_STATS_INIT_SIZE;
+	bp->stats = (struct branch_stat *)calloc(bp->stats_size, sizeof(struct branch_stat));
+	failed |= bp->stats == NULL;
+	if (types & (1UL << BPRED_BIMODAL)) failed |= (bp->bimodal = counters_alloc(entries)) == NULL;
+	if (types & (1UL << BPRED_GSHARE)) failed |= (bp->gshare = counters_alloc(entries)) == NULL;
+	if (types & (1UL << BPRED_TAGE)) {
+		failed |= (bp->tage_base = counters_alloc(entries)) == NULL;
+		for (int t = 0; t < TAGE_TABLES; t++) {
+			bp->tage[t] = (struct tage_entry *)calloc(1UL << bp->tage_bits, sizeof(struct tage_entry));
+			failed |= bp->tage[t] == NULL;
+		}
+	}
+	if (types & (1UL << BPRED_BTB)) {
+		bp->btb_pc = (unsigned long *)calloc(btb_entries, sizeof(unsigned long));
+		bp->btb_target = (unsigned long *)calloc(btb_entries, sizeof(unsigned long));
+		failed |= bp->btb_pc == NULL || bp->btb_target == NULL;
+	}
+	if (types & (1UL << BPRED_RAS)) failed |= (bp->ras = (unsigned long *)calloc(ras_entries, sizeof(unsigned long))) == NULL;
+	if (failed) {
+		perror("Failed to allocate branch predictor tables");
+		bpred_free(bp);
+		return NULL;
+	}
+
+	return bp;
+}
+
+
+void bpred_free(struct bpred *bp) {
+	if (bp == NULL) return;
+	free(bp->bimodal);
+	free(bp->gshare);
+	free(bp->tage_base);
+	for (int t = 0; t < TAGE_TABLES; t++) {
+		free(bp->tage[t]);
+	}
+	free(bp->btb_pc);
+	free(bp->btb_target);
+	free(bp->ras);
+	free(bp->stats);
+	free(bp);
+}
+
+
+static struct branch_stat *stats_slot(struct branch_stat *stats, unsigned long size, unsigned long pc) {
+	unsigned long i = ((pc >> 2) * 0x9e3779b97f4a7c15UL) & (size - 1);
+
+	while (stats[i].executed != 0 && stats[i].pc != pc) {
+		i = (i + 1) & (size - 1);
+	}
+	return &stats[i];
+}
+
+
+// The statistics of the branch at `pc`, NULL if there's no memory to track a new one
+static struct branch_stat *stats_lookup(struct bpred *bp, struct instruction *i) {
+	struct branch_stat *s = stats_slot(bp->stats, bp->stats_size, i->inst_addr);
+
+	if (s->executed != 0) return s;
+	// Double the table when it is half full
+	if (bp->stats_count + 1 > bp->stats_size / 2) {
+		unsigned long size = bp->stats_size * 2;
+		struct branch_stat *stats = (struct branch_stat *)calloc(size, sizeof(struct branch_stat));
+
+		if (stats == NULL) {
+			perror("Failed to grow branch statistics");
+			return NULL;
+		}
+		for (unsigned long j = 0; j < bp->stats_size; j++) {
+			if (bp->stats[j].executed != 0) *stats_slot(stats, size, bp->stats[j].pc) = bp->stats[j];
+		}
+		free(bp->stats);
+		bp->stats = stats;
+		bp->stats_size = size;
+		s = stats_slot(bp->stats, bp->stats_size, i->inst_addr);
+	}
+	s->pc = i->inst_addr;
+	s->inst_no = i->inst_no;
+	bp->stats_count++;
+
+	return s;
+}
+
+
+static void outcome(struct bpred *bp, struct branch_stat *s, enum bpred_type t, int correct) {
+	bp->predictions[t]++;
+	bp->wrong[t] = !correct;
+	if (correct) return;
+	bp->mispredicts[t]++;
+	if (s != NULL) s->mispredicts[t]++;
+}
+
+
+// Predict with a 2-bit counter, then train it
+static int counter_predict(unsigned char *c, int taken) {
+	int pred = *c >= 2;
+
+	if (taken && *c < 3) (*c)++;
+	if (!taken && *c > 0) (*c)--;
+	return pred;
+}
+
+
+// The last `len` outcomes, xor-folded down to `bits` bits
+static unsigned long history_fold(unsigned long history, unsigned int len, unsigned long bits) {
+	unsigned long h = len < 64 ? history & ((1UL << len) - 1) : history, folded = 0;
+
+	while (h != 0) {
+		folded ^= h & ((1UL << bits) - 1);
+		h >>= bits;
+	}
+	return folded;
+}
+
+
+static int tage_predict(struct bpred *bp, unsigned long pc, int taken) {
+	unsigned long mask = (1UL << bp->tage_bits) - 1, idx[TAGE_TABLES];
+	unsigned short tag[TAGE_TABLES];
+	unsigned char *base = &bp->tage_base[(pc >> 2) & ((1UL << bp->index_bits) - 1)];
+	int provider = -1, alt = -1, pred, alt_pred;
+
+	for (int t = 0; t < TAGE_TABLES; t++) {
+		idx[t] = ((pc >> 2) ^ (pc >> (2 + bp->tage_bits)) ^ history_fold(bp->history, tage_history[t], bp->tage_bits)) & mask;
+		tag[t] = (((pc >> 2) ^ history_fold(bp->history, tage_history[t], TAGE_TAG_BITS) ^
+			   (history_fold(bp->history, tage_history[t], TAGE_TAG_BITS - 1) << 1)) & ((1UL << TAGE_TAG_BITS) - 1)) + 1;
+	}
+	// The longest matching history provides the prediction, the next one is the alternative
+	for (int t = TAGE_TABLES - 1; t >= 0 && alt < 0; t--) {
+		if (bp->tage[t][idx[t]].tag != tag[t]) continue;
+		if (provider < 0) {
+			provider = t;
+		} else {
+			alt = t;
+		}
+	}
+	alt_pred = alt >= 0 ? bp->tage[alt][idx[alt]].ctr >= 0 : *base >= 2;
+
+	if (provider < 0) {
+		pred = counter_predict(base, taken);
+	} else {
+		struct tage_entry *e = &bp->tage[provider][idx[provider]];
+
+		pred = e->ctr >= 0;
+		// An entry is useful when it is right where the alternative isn't
+		if (pred != alt_pred) {
+			if (pred == taken && e->useful < 3) e->useful++;
+			if (pred != taken && e->useful > 0) e->useful--;
+		}
+		if (taken && e->ctr < 3) e->ctr++;
+		if (!taken && e->ctr > -4) e->ctr--;
+	}
+
+	// On a mispredict, start tracking the branch with a longer history
+	if (pred != taken) {
+		int allocated = 0;
+
+		for (int t = provider + 1; t < TAGE_TABLES && !allocated; t++) {
+			struct tage_entry *e = &bp->tage[t][idx[t]];
+
+			if (e->useful != 0) continue;
+			*e = (struct tage_entry){ .tag = tag[t], .ctr = taken ? 0 : -1, .useful = 0 };
+			allocated = 1;
+		}
+		for (int t = provider + 1; t < TAGE_TABLES && !allocated; t++) {
+			if (bp->tage[t][idx[t]].useful > 0) bp->tage[t][idx[t]].useful--;
+		}
+	}
+	if (++bp->tage_branches % TAGE_RESET_PERIOD == 0) {
+		for (int t = 0; t < TAGE_TABLES; t++) {
+			for (unsigned long j = 0; j <= mask; j++) {
+				bp->tage[t][j].useful >>= 1;
+			}
+		}
+	}
+
+	return pred;
+}
+
+
+static void btb_predict(struct bpred *bp, struct branch_stat *s, unsigned long pc, unsigned long target) {
+	unsigned long j = (pc >> 2) & (bp->btb_entries - 1);
+
+	outcome(bp, s, BPRED_BTB, bp->btb_pc[j] == pc + 1 && bp->btb_target[j] == target);
+	bp->btb_pc[j] = pc + 1;
+	bp->btb_target[j] = target;
+}
+
+
+// x1 (ra) and x5 (t0) are the link registers
+static int is_link(unsigned int r) {
+	return r == 1 || r == 5;
+}
+
+
+void bpred_branch(struct bpred *bp, struct instruction *i, int taken, unsigned long target) {
+	unsigned long pc = i->inst_addr;
+	struct branch_stat *s;
+	int push = 0, pop = 0;
+
+	if (bp == NULL) return;
+	switch (instr_class(i->inst_no)) {
+	case CLASS_BRANCH:
+		break;
+	case CLASS_JUMP:
+		taken = 1;
+		if (i->inst_no == JAL) {
+			push = is_link(i->format.ri.rd);
+		} else {
+			// The hints of the RISC-V spec: a jalr linking into the register it jumps through calls
+			push = is_link(i->format.ror.r2);
+			pop = is_link(i->format.ror.r1) && (!is_link(i->format.ror.r2) || i->format.ror.r1 != i->format.ror.r2);
+		}
+		break;
+	default:
+		return;
+	}
+	memset(bp->wrong, 0, sizeof(bp->wrong));
+	s = stats_lookup(bp, i);
+	if (s != NULL) {
+		s->executed++;
+		if (taken) s->taken++;
+	}
+
+	if (instr_class(i->inst_no) == CLASS_BRANCH) {
+		bp->num_branches++;
+		if (taken) bp->num_taken++;
+		if (bp->types & (1UL << BPRED_STATIC)) {
+			// Backward branches close loops
+			outcome(bp, s, BPRED_STATIC, (i->format.rri.imm < 0) == !!taken);
+		}
+		if (bp->bimodal) {
+			outcome(bp, s, BPRED_BIMODAL, counter_predict(&bp->bimodal[(pc >> 2) & ((1UL << bp->index_bits) - 1)], taken) == !!taken);
+		}
+		if (bp->gshare) {
+			unsigned long j = ((pc >> 2) ^ bp->history) & ((1UL << bp->index_bits) - 1);
+
+			outcome(bp, s, BPRED_GSHARE, counter_predict(&bp->gshare[j], taken) == !!taken);
+		}
+		if (bp->tage[0]) outcome(bp, s, BPRED_TAGE, tage_predict(bp, pc, taken) == !!taken);
+		bp->history = (bp->history << 1) | !!taken;
+		if (bp->btb_pc && taken) btb_predict(bp, s, pc, target);
+		return;
+	}
+
+	bp->num_jumps++;
+	if (push) bp->num_calls++;
+	if (pop) {
+		bp->num_returns++;
+		if (bp->ras) {
+			int correct = 0;
+
+			if (bp->ras_count > 0) {
+				bp->ras_top = (bp->ras_top + bp->ras_entries - 1) % bp->ras_entries;
+				bp->ras_count--;
+				correct = bp->ras[bp->ras_top] == target;
+			}
+			outcome(bp, s, BPRED_RAS, correct);
+		}
+	} else if (bp->btb_pc) {
+		// Returns are the return-address stack's to predict
+		btb_predict(bp, s, pc, target);
+	}
+	if (push && bp->ras) {
+		bp->ras[bp->ras_top] = pc + 4;
+		bp->ras_top = (bp->ras_top + 1) % bp->ras_entries;
+		if (bp->ras_count < bp->ras_entries) bp->ras_count++;
+	}
+}
+
+
+int bpred_mispredicted(struct bpred *bp) {
+	if (bp == NULL) return 0;
+	for (int t = BPRED_TAGE; t >= BPRED_STATIC; t--) {
+		if (bp->types & (1UL << t)) {
+			if (bp->wrong[t]) return 1;
+			break;
+		}
+	}
+	return bp->wrong[BPRED_BTB] || bp->wrong[BPRED_RAS];
+}
+
+
+static unsigned long total_mispredicts(const struct branch_stat *s) {
+	unsigned long n = 0;
+
+	for (int t = 0; t < BPRED_COUNT; t++) {
+		n += s->mispredicts[t];
+	}
+	return n;
+}
+
+
+// Most mispredictions (over all the predictors) first, then the lowest pc
+static int branch_stat_cmp(const void *a, const void *b) {
+	const struct branch_stat *x = *(const struct branch_stat **)a, *y = *(const struct branch_stat **)b;
+	unsigned long mx = total_mispredicts(x), my = total_mispredicts(y);
+
+	if (mx != my) return mx > my ? -1 : 1;
+	return x->pc < y->pc ? -1 : (x->pc > y->pc);
+}
+
+
+void bpred_stats_reset(struct bpred *bp) {
+	if (bp == NULL) return;
+	memset(bp->predictions, 0, sizeof(bp->predictions));
+	memset(bp->mispredicts, 0, sizeof(bp->mispredicts));
+	bp->num_branches = bp->num_taken = bp->num_jumps = bp->num_calls = bp->num_returns = 0;
+	memset(bp->stats, 0, bp->stats_size * sizeof(struct branch_stat));
+	bp->stats_count = 0;
+}
+
+
+void bpred_print(struct bpred *bp, unsigned long num_instrs) {
+	struct branch_stat **branches;
+	unsigned long n = 0;
+	char config[128];
+
+	if (bp == NULL) return;
+	printf("Branch Prediction: Conditional Branches: %lu (%.2f%% taken), Jumps: %lu, Calls: %lu, Returns: %lu\n",
+		bp->num_branches, bp->num_branches == 0 ? 0.0 : ((double)bp->num_taken / (double)bp->num_branches) * 100.0,
+		bp->num_jumps, bp->num_calls, bp->num_returns);
+	printf("%-10s %-36s %14s %14s %10s %8s\n", "Predictor", "Configuration", "Predictions", "Mispredicts", "Accuracy", "MPKI");
+	for (int t = 0; t < BPRED_COUNT; t++) {
+		if (!(bp->types & (1UL << t))) continue;
+		switch (t) {
+		case BPRED_STATIC:
+			snprintf(config, sizeof(config), "backward taken");
+			break;
+		case BPRED_BIMODAL:
+			snprintf(config, sizeof(config), "%lu counters", 1UL << bp->index_bits);
+			break;
+		case BPRED_GSHARE:
+			snprintf(config, sizeof(config), "%lu counters, %lu-bit history", 1UL << bp->index_bits, bp->index_bits);
+			break;
+		case BPRED_TAGE:
+			snprintf(config, sizeof(config), "%lu + %dx%lu entries, %u-%u history", 1UL << bp->index_bits,
+				 TAGE_TABLES, 1UL << bp->tage_bits, tage_history[0], tage_history[TAGE_TABLES - 1]);
+			break;
+		case BPRED_BTB:
+			snprintf(config, sizeof(config), "%lu entries", bp->btb_entries);
+			break;
+		case BPRED_RAS:
+			snprintf(config, sizeof(config), "%lu entries", bp->ras_entries);
+			break;
+		}
+		printf("%-10s %-36s %14lu %14lu %9.2f%% %8.3f\n", bpred_names[t], config, bp->predictions[t], bp->mispredicts[t],
+			bp->predictions[t] == 0 ? 0.0 :
+			(((double)bp->predictions[t] - (double)bp->mispredicts[t]) / (double)bp->predictions[t]) * 100.0,
+			num_instrs == 0 ? 0.0 : ((double)bp->mispredicts[t] * 1000.0) / (double)num_instrs);
+	}
+
+	// The branches mispredicted the most, by each predictor
+	branches = (struct branch_stat **)malloc(bp->stats_count * sizeof(struct branch_stat *) + 1);
+	if (branches == NULL) {
+		perror("Failed to sort branch statistics");
+		return;
+	}
+	for (unsigned long j = 0; j < bp->stats_size; j++) {
+		if (bp->stats[j].executed != 0 && total_mispredicts(&bp->stats[j]) > 0) branches[n++] = &bp->stats[j];
+	}
+	qsort(branches, n, sizeof(struct branch_stat *), branch_stat_cmp);
+	if (n > BPRED_TOP_BRANCHES) n = BPRED_TOP_BRANCHES;
+	if (n > 0) {
+		printf("Most Mispredicted Branches:\n");
+		printf("%18s %-6s %12s %8s", "Branch", "", "Executed", "Taken");
+		for (int t = 0; t < BPRED_COUNT; t++) {
+			if (bp->types & (1UL << t)) printf(" %10s", bpred_names[t]);
+		}
+		printf("\n");
+	}
+	for (unsigned long j = 0; j < n; j++) {
+		struct branch_stat *s = branches[j];
+
+		printf("%#18lx %-6s %12lu %7.2f%%", s->pc, instr_name(s->inst_no), s->executed,
+			((double)s->taken / (double)s->executed) * 100.0);
+		for (int t = 0; t < BPRED_COUNT; t++) {
+			if (bp->types & (1UL << t)) printf(" %10lu", s->mispredicts[t]);
+		}
+		printf("\n");
+	}
+	free(branches);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <instructions.h>
+
+/*
+ * Branch prediction, simulated side by side: every control-flow instruction executed is shown
+ * to each of the enabled predictors, which predict it, then learn its outcome.
+ *
+ * The direction predictors guess whether conditional branches are taken:
+ *
+ * - static: backward taken, forward not taken (loops are taken).
+ * - bimodal: a table of 2-bit saturating counters indexed by the pc.
+ * - gshare: the same counters, indexed by the pc xor the global history of outcomes.
+ * - tage: a bimodal base and four tagged tables indexed with 4, 8, 16 and 32 bits of history
+ *   (a "lite" TAGE), the longest history that matches providing the prediction.
+ *
+ * The target predictors guess where taken branches and jumps go:
+ *
+ * - btb: a direct-mapped branch target buffer, predicting every taken branch and jump but
+ *   returns, which miss if the pc isn't in it or its target changed.
+ * - ras: a return-address stack, driven by the RISC-V link conventions: a jal/jalr linking
+ *   into x1 or x5 is a call and pushes its return address, and a jalr through x1 or x5 that
+ *   doesn't link is a return and pops its prediction. It wraps around when it overflows.
+ */
+
+enum bpred_type {
+	BPRED_STATIC,
+	BPRED_BIMODAL,
+	BPRED_GSHARE,
+	BPRED_TAGE,
+	BPRED_BTB,
+	BPRED_RAS,
+	BPRED_COUNT,
+};
+
+/* Define this as you'd like in your .c file. */
+struct bpred;
+
+/*
+ * Allocate the predictors.
+ *
+ * @param types A bitmask of the predictors to simulate, bit `1 << BPRED_*`.
+ * @param index_bits log2 of the entries of the bimodal and gshare tables and of TAGE's base,
+ *        gshare's history length (TAGE's tagged tables have a quarter as many entries).
+ * @param btb_entries The entries of the BTB, a power of two.
+ * @param ras_entries The depth of the return-address stack.
+ * @return The predictors, or NULL on error.
+ */
+struct bpred *bpred_alloc(unsigned long types, unsigned long index_bits, unsigned long btb_entries, unsigned long ras_entries);
+void bpred_free(struct bpred *bp);
+
+/*
+ * Predict, then update the predictors with, one executed control-flow instruction.
+ *
+ * @param bp The predictors.
+ * @param i The instruction, other than branches and jumps are ignored.
+ * @param taken Non-zero if a branch was taken (jumps always are).
+ * @param target The address it went to when taken.
+ */
+void bpred_branch(struct bpred *bp, struct instruction *i, int taken, unsigned long target);
+
+/*
+ * Whether the front end mispredicted the last branch or jump: its direction according to the
+ * most elaborate direction predictor simulated, and for taken ones, its target according to
+ * the return-address stack (returns) or the BTB (the others). Predictors that aren't
+ * simulated are taken to be perfect.
+ *
+ * @param bp The predictors, NULL for perfect prediction.
+ * @return 1 if it was mispredicted, 0 if not.
+ */
+int bpred_mispredicted(struct bpred *bp);
+
+/*
+ * Parse a comma-separated list of predictor names into a bitmask.
+ *
+ * @param list e.g. "gshare,tage,ras".
+ * @return The bitmask, or -1 if a name is unknown.
+ */
+long bpred_parse(const char *list);
+
+/* Zero the predictions, mispredictions and per-branch counts, keeping the predictors trained */
+void bpred_stats_reset(struct bpred *bp);
+
+/*
+ * Print each predictor's accuracy and mispredictions per thousand instructions, then the
+ * branches mispredicted the most.
+ *
+ * @param bp The predictors.
+ * @param num_instrs The number of instructions executed.
+ */
+void bpred_print(struct bpred *bp, unsigned long num_instrs);
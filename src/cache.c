@@ -1,39 +1,130 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
-#include "cache.h" 
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include "cache.h"
+#include "prefetch.h"
+#include "ring.h"
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
-struct cache_line {
-	int valid;          // Indicating if the line holds valid data (1) or not (0)
-	unsigned long tag;  // Stores the tag part of the address
+// Maximum number of prefetches that can be in flight at once
+#define PREFETCH_QUEUE_MAX 64
+// Entries in the filter remembering which lines were evicted by prefetches
+#define POLLUTION_FILTER_SIZE 1024
+// The per-set valid/prefetched bitmasks are one unsigned long
+#define CACHE_WAYS_MAX 64
+// Block addresses buffered per shard before they are handed to its thread
+#define SHARD_BATCH 256
+// Capacity of each shard's queue, in block addresses
+#define SHARD_RING_SIZE (64 * 1024)
+
+// An entry of the small fully-associative buffer behind the cache
+struct victim_entry {
+	int valid;
+	unsigned long block;
+	unsigned long lru;
+};
+
+// A prefetch that has been issued, but hasn't reached the cache yet
+struct prefetch_request {
+	unsigned long block;    // Block address being prefetched
+	unsigned long ready_at; // Access count at which the line arrives
+	int valid;              // Cleared when a demand access catches up with it
 };
 
-// Main cache structure
+/*
+ * A worker thread simulating a contiguous range of the sets of a cache. Sets never share
+ * lines, so each range is an independent cache: its thread only needs the accesses that
+ * map to its sets, in their original order.
+ */
+struct cache_shard {
+	struct cache *c;                   // Simulates sets [first_set, first_set + c->num_sets)
+	unsigned long first_set;
+	struct ring *ring;                 // Block addresses local to `c`
+	unsigned long batch[SHARD_BATCH];  // Not yet pushed to the ring
+	unsigned long batch_len;
+	unsigned long num_pushed;          // Only used by the emulator's thread
+	_Atomic unsigned long num_done;    // Accesses the worker has simulated
+	pthread_t thread;
+};
+
+struct cache;
+typedef int (*cache_access_fn)(struct cache *c, unsigned long mem_addr);
+
+/*
+ * Main cache structure. The lines are stored as a structure of arrays: the tags of the
+ * ways of a set are packed next to each other so that a lookup compares all of them at
+ * once (see `cache_match`), and the per-line flags are bitmasks with one bit per way.
+ */
 struct cache {
-	struct cache_line *lines; // An array where each element represents a cache set/line
-	unsigned long num_sets;   // The total number of sets (and lines) in the cache
+	unsigned long *tags;       // num_sets * num_ways tags, the ways of a set are contiguous
+	unsigned long *lru;        // Access count of the last use of each line, same layout as tags
+	unsigned long *valid;      // Per set, bit w is set if way w holds valid data
+	unsigned long *prefetched; // Per set, bit w is set if way w was prefetched and not yet used
+	unsigned long num_sets;    // The total number of sets in the cache
+	unsigned long num_ways;    // Lines per set, 1 for a direct-mapped cache
+	cache_access_fn access;    // Specialized access path for this geometry, NULL for the generic one
 
 	// Statistics counters
 	unsigned long num_cache_accesses; // Total number of times cache_access was called
 	unsigned long num_cache_misses;   // Total number of cache misses occurred
+
+	// Prefetching state, only used when a prefetcher is attached
+	struct prefetcher *pf;
+	unsigned long prefetch_latency;
+	struct prefetch_request pf_queue[PREFETCH_QUEUE_MAX]; // FIFO ring of in-flight prefetches
+	unsigned long pf_head, pf_count;
+	unsigned long *pollution_filter; // Block address + 1 of lines evicted by prefetches, 0 if empty
+	unsigned long num_prefetches, num_prefetch_useful, num_prefetch_late, num_prefetch_polluting;
+
+	// Victim/miss cache, only used when one is attached
+	struct victim_entry *victims;
+	unsigned long num_victims;
+	enum victim_mode victim_mode;
+	unsigned long num_victim_hits;
+
+	// Block address + 1 of the line the last generic access evicted, 0 if none
+	unsigned long last_evicted;
+
+	// Ways the generic access may fill, 0 for all of them (see `cache_access_ways`)
+	unsigned long fill_mask;
+
+	// Set-sharded simulation, only used when the cache has worker threads
+	struct cache_shard *shards;
+	unsigned long num_shards;
+	unsigned long sets_per_shard;
 };
 
+static void cache_select_access(struct cache *c);
+static void cache_shards_free(struct cache *c);
+
 
 struct cache *cache_allocate(unsigned long num_cache_lines, unsigned long num_sets) {
-	if (num_cache_lines != num_sets) {
-		fprintf(stderr, "Error: For direct-mapped cache simulation, num_cache_lines (%lu) must equal num_sets (%lu).\n",
-				num_cache_lines, num_sets);
-	}
 	// Cache must have at least one set/line.
 	if (num_sets == 0) {
 		fprintf(stderr, "Error: Cache must have at least one set (num_sets cannot be 0).\n");
 		return NULL; // Indicate failure
 	}
+	// Every set has the same number of ways (num_cache_lines == num_sets is direct-mapped)
+	if (num_cache_lines < num_sets || num_cache_lines % num_sets != 0) {
+		fprintf(stderr, "Error: num_cache_lines (%lu) must be a multiple of num_sets (%lu).\n",
+				num_cache_lines, num_sets);
+		return NULL;
+	}
+	if (num_cache_lines / num_sets > CACHE_WAYS_MAX) {
+		fprintf(stderr, "Error: At most %d ways per set are supported.\n", CACHE_WAYS_MAX);
+		return NULL;
+	}
 
 
-	// Allocate memory for the main cache structure itself
-	struct cache *c = (struct cache *)malloc(sizeof(struct cache));
+	// Allocate memory for the main cache structure itself. calloc zeroes the
+	// statistics and leaves the cache without a prefetcher.
+	struct cache *c = (struct cache *)calloc(1, sizeof(struct cache));
 	if (c == NULL) {
 		perror("Failed to allocate cache structure");
 		return NULL; // Allocation failed
@@ -41,18 +132,23 @@ struct cache *cache_allocate(unsigned long num_cache_lines, unsigned long num_se
 
 	// Initialize the cache properties and statistics
 	c->num_sets = num_sets;
+	c->num_ways = num_cache_lines / num_sets;
 	c->num_cache_accesses = 0;
 	c->num_cache_misses = 0;
 
-	// Allocate memory for the array of cache lines (one per set)
+	// Allocate memory for the line arrays (num_ways per set) and the per-set bitmasks.
 	// Use calloc to allocate and zero-initialize the memory. This sets
 	// valid = 0 and tag = 0 for all lines initially.
-	c->lines = (struct cache_line *)calloc(num_sets, sizeof(struct cache_line));
-	if (c->lines == NULL) {
+	c->tags = (unsigned long *)calloc(num_cache_lines, sizeof(unsigned long));
+	c->lru = (unsigned long *)calloc(num_cache_lines, sizeof(unsigned long));
+	c->valid = (unsigned long *)calloc(num_sets, sizeof(unsigned long));
+	c->prefetched = (unsigned long *)calloc(num_sets, sizeof(unsigned long));
+	if (c->tags == NULL || c->lru == NULL || c->valid == NULL || c->prefetched == NULL) {
 		perror("Failed to allocate cache lines array");
-		free(c); // Clean up the partially allocated cache structure
+		cache_free(c); // Clean up the partially allocated cache structure
 		return NULL; // Allocation failed
 	}
+	cache_select_access(c);
 
 	return c; // Return the pointer to the successfully allocated and initialized cache
 }
@@ -60,65 +156,640 @@ struct cache *cache_allocate(unsigned long num_cache_lines, unsigned long num_se
 
 void cache_free(struct cache *c) {
 	if (c != NULL) {
-		// Free the array of cache lines first, if it was allocated
-		if (c->lines != NULL) {
-			free(c->lines);
-			c->lines = NULL; 
-		}
+		// Stop the worker threads before anything they use goes away
+		cache_shards_free(c);
+		// Free the line arrays first (free ignores the ones that weren't allocated)
+		free(c->tags);
+		free(c->lru);
+		free(c->valid);
+		free(c->prefetched);
+		prefetcher_free(c->pf);
+		free(c->pollution_filter);
+		free(c->victims);
 		// Then free the cache structure itself
 		free(c);
 	}
 }
 
 
-void cache_access(struct cache *c, unsigned long mem_addr) {
-	// Basic validation
-	if (c == NULL || c->lines == NULL) {
-		fprintf(stderr, "Error: cache_access called on an uninitialized or invalid cache.\n");
-		return; 
+void cache_set_prefetcher(struct cache *c, struct prefetcher *pf, unsigned long latency) {
+	if (c == NULL) return;
+
+	prefetcher_free(c->pf);
+	c->pf = pf;
+	c->prefetch_latency = latency;
+	c->pf_head = c->pf_count = 0;
+
+	if (pf != NULL && c->pollution_filter == NULL) {
+		c->pollution_filter = (unsigned long *)calloc(POLLUTION_FILTER_SIZE, sizeof(unsigned long));
+		if (c->pollution_filter == NULL) {
+			perror("Failed to allocate prefetch pollution filter");
+		}
+	}
+	cache_select_access(c);
+}
+
+
+int cache_set_victim(struct cache *c, unsigned long num_entries, enum victim_mode mode) {
+	if (c == NULL) return -1;
+
+	free(c->victims);
+	c->victims = NULL;
+	c->num_victims = 0;
+	c->victim_mode = mode;
+	cache_select_access(c);
+	if (num_entries == 0) return 0;
+
+	c->victims = (struct victim_entry *)calloc(num_entries, sizeof(struct victim_entry));
+	if (c->victims == NULL) {
+		perror("Failed to allocate victim cache");
+		return -1;
+	}
+	c->num_victims = num_entries;
+	cache_select_access(c);
+
+	return 0;
+}
+
+
+
+// Simulate the accesses of one shard as they arrive, until the cache is freed
+static void *cache_shard_worker(void *arg) {
+	struct cache_shard *s = (struct cache_shard *)arg;
+	unsigned long blocks[SHARD_BATCH];
+	unsigned long n;
+
+	while ((n = ring_pop_wait(s->ring, blocks, SHARD_BATCH)) > 0) {
+		for (unsigned long i = 0; i < n; i++) {
+			cache_access(s->c, blocks[i] * CACHE_BLOCK_SIZE);
+		}
+		atomic_fetch_add_explicit(&s->num_done, n, memory_order_release);
+	}
+
+	return NULL;
+}
+
+
+static void cache_shards_free(struct cache *c) {
+	for (unsigned long i = 0; i < c->num_shards; i++) {
+		struct cache_shard *s = &c->shards[i];
+
+		if (s->ring != NULL) {
+			ring_close(s->ring);
+			pthread_join(s->thread, NULL);
+			ring_free(s->ring);
+		}
+		cache_free(s->c);
+	}
+	free(c->shards);
+	c->shards = NULL;
+	c->num_shards = 0;
+}
+
+
+int cache_set_threads(struct cache *c, unsigned long num_threads) {
+	if (c == NULL) return -1;
+	if (num_threads > c->num_sets) num_threads = c->num_sets;
+	if (num_threads <= 1) return 0;
+	if (c->pf != NULL || c->num_victims > 0) {
+		fprintf(stderr, "Error: Prefetchers and victim caches span sets, so the cache cannot be split between threads.\n");
+		return -1;
+	}
+	if (c->num_cache_accesses > 0 || c->num_shards > 0) {
+		fprintf(stderr, "Error: Cache threads must be set up before the first access.\n");
+		return -1;
+	}
+
+	c->sets_per_shard = (c->num_sets + num_threads - 1) / num_threads;
+	c->num_shards = (c->num_sets + c->sets_per_shard - 1) / c->sets_per_shard;
+	c->shards = (struct cache_shard *)calloc(c->num_shards, sizeof(struct cache_shard));
+	if (c->shards == NULL) {
+		perror("Failed to allocate cache shards");
+		c->num_shards = 0;
+		return -1;
+	}
+	for (unsigned long i = 0; i < c->num_shards; i++) {
+		struct cache_shard *s = &c->shards[i];
+		unsigned long first = i * c->sets_per_shard;
+		unsigned long sets = c->num_sets - first < c->sets_per_shard ? c->num_sets - first : c->sets_per_shard;
+
+		s->first_set = first;
+		atomic_init(&s->num_done, 0);
+		s->c = cache_allocate(sets * c->num_ways, sets);
+		if (s->c == NULL) goto err;
+		s->ring = ring_alloc(SHARD_RING_SIZE);
+		if (s->ring == NULL) goto err;
+		if (pthread_create(&s->thread, NULL, cache_shard_worker, s) != 0) {
+			fprintf(stderr, "Error: Failed to start a cache thread.\n");
+			ring_free(s->ring);
+			s->ring = NULL;
+			goto err;
+		}
+	}
+
+	return 0;
+err:
+	cache_shards_free(c);
+	return -1;
+}
+
+
+// Hand an access to the thread simulating its set
+static void cache_shard_access(struct cache *c, unsigned long mem_addr) {
+	unsigned long block = mem_addr / CACHE_BLOCK_SIZE;
+	unsigned long set = block % c->num_sets;
+	struct cache_shard *s = &c->shards[set / c->sets_per_shard];
+	unsigned long local_sets = s->c->num_sets;
+
+	// Renumber the block so that it maps to the same set in the shard's smaller cache, and
+	// keeps a distinct tag: (block / num_sets, set) identifies the block
+	s->batch[s->batch_len++] = (block / c->num_sets) * local_sets + (set - s->first_set);
+	if (s->batch_len == SHARD_BATCH) {
+		ring_push(s->ring, s->batch, s->batch_len);
+		s->num_pushed += s->batch_len;
+		s->batch_len = 0;
+	}
+}
+
+
+// Push out the buffered accesses and wait for the threads to simulate all of them
+static void cache_shards_sync(struct cache *c) {
+	for (unsigned long i = 0; i < c->num_shards; i++) {
+		struct cache_shard *s = &c->shards[i];
+
+		if (s->batch_len > 0) {
+			ring_push(s->ring, s->batch, s->batch_len);
+			s->num_pushed += s->batch_len;
+			s->batch_len = 0;
+		}
+	}
+	for (unsigned long i = 0; i < c->num_shards; i++) {
+		struct cache_shard *s = &c->shards[i];
+
+		while (atomic_load_explicit(&s->num_done, memory_order_acquire) < s->num_pushed) {
+			sched_yield();
+		}
+	}
+}
+
+/*
+ * Compare a tag against all of the ways of a set at once, and return the bitmask of the
+ * ways that match (valid or not). AVX2 compares four tags per instruction and SSE2 two;
+ * without either we fall back to one compare per way.
+ */
+static inline unsigned long cache_match(const unsigned long *tags, unsigned long num_ways, unsigned long tag) {
+	unsigned long mask = 0, w = 0;
+
+#if defined(__AVX2__)
+	__m256i key = _mm256_set1_epi64x((long long)tag);
+	for (; w + 4 <= num_ways; w += 4) {
+		__m256i eq = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)&tags[w]), key);
+		mask |= (unsigned long)_mm256_movemask_pd(_mm256_castsi256_pd(eq)) << w;
+	}
+#endif
+#if defined(__SSE2__)
+	__m128i key2 = _mm_set1_epi64x((long long)tag);
+	for (; w + 2 <= num_ways; w += 2) {
+		// SSE2 has no 64-bit compare: both 32-bit halves of a tag must be equal
+		__m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)&tags[w]), key2);
+		eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+		mask |= (unsigned long)_mm_movemask_pd(_mm_castsi128_pd(eq)) << w;
+	}
+#endif
+	for (; w < num_ways; w++) {
+		mask |= (unsigned long)(tags[w] == tag) << w;
+	}
+	return mask;
+}
+
+
+/*
+ * Return the way holding a block in its set, or -1 if it isn't cached. The `_n` versions
+ * take the number of ways as an argument so that the specialized access paths below can
+ * pass a constant, and have the compiler unroll the way loops.
+ */
+static inline long cache_lookup_n(struct cache *c, unsigned long set, unsigned long block, unsigned long num_ways) {
+	unsigned long hits = cache_match(&c->tags[set * num_ways], num_ways, block) & c->valid[set];
+
+	return hits ? (long)__builtin_ctzl(hits) : -1;
+}
+
+static inline long cache_lookup(struct cache *c, unsigned long set, unsigned long block) {
+	return cache_lookup_n(c, set, block, c->num_ways);
+}
+
+
+// Pick the way a block replaces in its set: an invalid one if possible, otherwise the LRU one
+static inline unsigned long cache_replacement_n(struct cache *c, unsigned long set, unsigned long num_ways) {
+	unsigned long all = num_ways == CACHE_WAYS_MAX ? ~0UL : (1UL << num_ways) - 1;
+	unsigned long invalid = ~c->valid[set] & all;
+	unsigned long *lru = &c->lru[set * num_ways];
+	unsigned long victim = 0;
+
+	if (invalid) return __builtin_ctzl(invalid);
+	for (unsigned long w = 1; w < num_ways; w++) {
+		if (lru[w] < lru[victim]) victim = w;
+	}
+	return victim;
+}
+
+// The same, only among the ways of `c->fill_mask` when it is set
+static inline unsigned long cache_replacement(struct cache *c, unsigned long set) {
+	unsigned long allowed = c->fill_mask, invalid, *lru = &c->lru[set * c->num_ways];
+	long victim = -1;
+
+	if (allowed == 0) return cache_replacement_n(c, set, c->num_ways);
+	invalid = ~c->valid[set] & allowed;
+	if (invalid) return __builtin_ctzl(invalid);
+	for (unsigned long w = 0; w < c->num_ways; w++) {
+		if ((allowed & (1UL << w)) && (victim < 0 || lru[w] < lru[victim])) victim = w;
+	}
+	return victim;
+}
+
+
+/*
+ * Specialized access paths for caches without a prefetcher or a victim cache, and with a
+ * power-of-two number of sets: the set index is a mask instead of a 64-bit modulo, and the
+ * number of ways is a compile-time constant. `cache_select_access` picks one (or the
+ * generic path in `cache_access_pc`) whenever the cache's configuration changes.
+ */
+#define CACHE_ACCESS_SPECIALIZE(name, ways, set_mask)				\
+static int name(struct cache *c, unsigned long mem_addr) {			\
+	unsigned long block = mem_addr / CACHE_BLOCK_SIZE;			\
+	unsigned long set = block & (set_mask);					\
+	long way = cache_lookup_n(c, set, block, (ways));			\
+	int hit = way >= 0;							\
+										\
+	c->num_cache_accesses++;						\
+	if (!hit) {								\
+		c->num_cache_misses++;						\
+		way = cache_replacement_n(c, set, (ways));			\
+		c->valid[set] |= 1UL << way;					\
+		c->tags[set * (ways) + way] = block;				\
+	}									\
+	c->lru[set * (ways) + way] = c->num_cache_accesses;			\
+										\
+	return hit;								\
+}
+
+CACHE_ACCESS_SPECIALIZE(cache_access_w1, 1, c->num_sets - 1)
+CACHE_ACCESS_SPECIALIZE(cache_access_w2, 2, c->num_sets - 1)
+CACHE_ACCESS_SPECIALIZE(cache_access_w4, 4, c->num_sets - 1)
+CACHE_ACCESS_SPECIALIZE(cache_access_w8, 8, c->num_sets - 1)
+CACHE_ACCESS_SPECIALIZE(cache_access_w16, 16, c->num_sets - 1)
+CACHE_ACCESS_SPECIALIZE(cache_access_w32, 32, c->num_sets - 1)
+
+/*
+ * The build's own geometry (the top-level Makefile's CACHE_LINES/CACHE_SETS) also gets a
+ * version where the number of sets is a constant.
+ */
+#if defined(CACHE_FIXED_LINES) && defined(CACHE_FIXED_SETS) && CACHE_FIXED_SETS > 0 && \
+    (CACHE_FIXED_SETS & (CACHE_FIXED_SETS - 1)) == 0 && CACHE_FIXED_LINES % CACHE_FIXED_SETS == 0 && \
+    CACHE_FIXED_LINES / CACHE_FIXED_SETS >= 1 && CACHE_FIXED_LINES / CACHE_FIXED_SETS <= CACHE_WAYS_MAX
+#define CACHE_FIXED_GEOMETRY
+CACHE_ACCESS_SPECIALIZE(cache_access_fixed, CACHE_FIXED_LINES / CACHE_FIXED_SETS, CACHE_FIXED_SETS - 1)
+#endif
+
+static const struct {
+	unsigned long num_ways;
+	cache_access_fn access;
+} cache_access_variants[] = {
+	{ 1, cache_access_w1 },
+	{ 2, cache_access_w2 },
+	{ 4, cache_access_w4 },
+	{ 8, cache_access_w8 },
+	{ 16, cache_access_w16 },
+	{ 32, cache_access_w32 },
+};
+
+// Choose the access path for the cache's current configuration, NULL means the generic one
+static void cache_select_access(struct cache *c) {
+	c->access = NULL;
+	if (c->pf != NULL || c->num_victims > 0) return;
+	if ((c->num_sets & (c->num_sets - 1)) != 0) return;
+
+#ifdef CACHE_FIXED_GEOMETRY
+	if (c->num_sets == CACHE_FIXED_SETS && c->num_ways == CACHE_FIXED_LINES / CACHE_FIXED_SETS) {
+		c->access = cache_access_fixed;
+		return;
 	}
+#endif
+	for (unsigned long i = 0; i < sizeof(cache_access_variants) / sizeof(cache_access_variants[0]); i++) {
+		if (cache_access_variants[i].num_ways == c->num_ways) {
+			c->access = cache_access_variants[i].access;
+			return;
+		}
+	}
+}
+
+
+// Return the victim/miss cache entry holding a block, or NULL
+static struct victim_entry *victim_lookup(struct cache *c, unsigned long block) {
+	for (unsigned long i = 0; i < c->num_victims; i++) {
+		if (c->victims[i].valid && c->victims[i].block == block) return &c->victims[i];
+	}
+	return NULL;
+}
+
+
+// Insert a block into the victim/miss cache, replacing its LRU entry
+static void victim_insert(struct cache *c, unsigned long block) {
+	struct victim_entry *e = &c->victims[0];
+
+	for (unsigned long i = 0; i < c->num_victims; i++) {
+		if (!c->victims[i].valid) {
+			e = &c->victims[i];
+			break;
+		}
+		if (c->victims[i].lru < e->lru) e = &c->victims[i];
+	}
+	*e = (struct victim_entry){ .valid = 1, .block = block, .lru = c->num_cache_accesses };
+}
+
+
+// Place a block in the cache, remembering which line a prefetch pushed out.
+static void cache_fill(struct cache *c, unsigned long block, int prefetched) {
+	unsigned long set = block % c->num_sets;
+	unsigned long way = cache_replacement(c, set);
+	unsigned long line = set * c->num_ways + way;
+	unsigned long bit = 1UL << way;
+
+	if (c->valid[set] & bit) {
+		unsigned long evicted = c->tags[line];
+
+		c->last_evicted = evicted + 1;
+		if (prefetched && c->pollution_filter != NULL) {
+			c->pollution_filter[evicted % POLLUTION_FILTER_SIZE] = evicted + 1;
+		}
+		// Jouppi's victim cache keeps what the cache evicts
+		if (c->num_victims > 0 && c->victim_mode == VICTIM_CACHE) {
+			victim_insert(c, evicted);
+		}
+	}
+	c->valid[set] |= bit;
+	c->prefetched[set] = prefetched ? (c->prefetched[set] | bit) : (c->prefetched[set] & ~bit);
+	c->tags[line] = block;
+	c->lru[line] = c->num_cache_accesses;
+}
+
+
+// Move every prefetch that has arrived by now from the queue into the cache.
+static void prefetch_drain(struct cache *c) {
+	while (c->pf_count > 0) {
+		struct prefetch_request *r = &c->pf_queue[c->pf_head];
+
+		if (r->valid && r->ready_at > c->num_cache_accesses) break;
+		// A demand access may have brought the block in from a victim/miss cache meanwhile
+		if (r->valid && cache_lookup(c, r->block % c->num_sets, r->block) < 0) cache_fill(c, r->block, 1);
+		c->pf_head = (c->pf_head + 1) % PREFETCH_QUEUE_MAX;
+		c->pf_count--;
+	}
+}
+
+
+// Find an in-flight prefetch for a block, or NULL.
+static struct prefetch_request *prefetch_inflight(struct cache *c, unsigned long block) {
+	for (unsigned long i = 0; i < c->pf_count; i++) {
+		struct prefetch_request *r = &c->pf_queue[(c->pf_head + i) % PREFETCH_QUEUE_MAX];
+
+		if (r->valid && r->block == block) return r;
+	}
+	return NULL;
+}
+
+
+// Ask the prefetcher what to fetch after this access, and issue what isn't already here.
+static void prefetch_issue(struct cache *c, unsigned long pc, unsigned long mem_addr, int hit) {
+	unsigned long candidates[PREFETCH_DEGREE_MAX];
+	int n = prefetcher_observe(c->pf, pc, mem_addr, hit, candidates, PREFETCH_DEGREE_MAX);
+
+	for (int i = 0; i < n; i++) {
+		unsigned long block = candidates[i] / CACHE_BLOCK_SIZE;
+
+		if (cache_lookup(c, block % c->num_sets, block) >= 0) continue;
+		if (prefetch_inflight(c, block) != NULL) continue;
+		if (c->num_victims > 0 && victim_lookup(c, block) != NULL) continue;
+
+		if (c->prefetch_latency == 0) {
+			c->num_prefetches++;
+			cache_fill(c, block, 1);
+			continue;
+		}
+		if (c->pf_count == PREFETCH_QUEUE_MAX) break; // Out of prefetch buffers, drop the rest
+
+		c->pf_queue[(c->pf_head + c->pf_count) % PREFETCH_QUEUE_MAX] = (struct prefetch_request){
+			.block = block,
+			.ready_at = c->num_cache_accesses + c->prefetch_latency,
+			.valid = 1,
+		};
+		c->pf_count++;
+		c->num_prefetches++;
+	}
+}
+
+
+void cache_access(struct cache *c, unsigned long mem_addr) {
+	cache_access_pc(c, 0, mem_addr);
+}
+
 
+// The access path that supports every option: prefetching, victim caches, and evictions
+static int cache_access_generic(struct cache *c, unsigned long pc, unsigned long mem_addr) {
 	// Increment the total number of cache accesses for statistics
 	c->num_cache_accesses++;
-
-	// Cache line size is fixed at 64 bytes
-	const unsigned long block_size = 64;
+	if (c->pf != NULL) prefetch_drain(c);
 
 	// Calculate the block address
-	unsigned long block_addr_tag = mem_addr / block_size;
+	unsigned long block_addr_tag = mem_addr / CACHE_BLOCK_SIZE;
 
-	// Calculate the index of the set where this address maps.
+	// Look for the block in all of the ways of the set it maps to
 	unsigned long set_index = block_addr_tag % c->num_sets;
+	long way = cache_lookup(c, set_index, block_addr_tag);
+	int hit;
 
-	// Get a pointer to the specific cache line corresponding to the calculated set index
-	struct cache_line *line = &c->lines[set_index];
-
-	// Check if the line is valid AND if the tag matches the current access's tag
-	if (line->valid && line->tag == block_addr_tag) {
+	if (way >= 0) {
 		// Cache Hit
+		hit = 1;
+		c->lru[set_index * c->num_ways + way] = c->num_cache_accesses;
+		if (c->prefetched[set_index] & (1UL << way)) {
+			c->num_prefetch_useful++;
+			c->prefetched[set_index] &= ~(1UL << way);
+		}
 	} else {
-		// Cache Miss
+		struct victim_entry *v = c->num_victims > 0 ? victim_lookup(c, block_addr_tag) : NULL;
+
+		if (v != NULL) {
+			// Victim/miss cache hit: the line moves back into the cache without going to memory
+			hit = 1;
+			c->num_victim_hits++;
+			if (c->pf != NULL) {
+				struct prefetch_request *r = prefetch_inflight(c, block_addr_tag);
+
+				// The line is back already, a prefetch still on its way is redundant
+				if (r != NULL) r->valid = 0;
+			}
+			if (c->victim_mode == VICTIM_CACHE) {
+				// Swap the two lines: the one we evict takes the buffer entry
+				v->valid = 0;
+				cache_fill(c, block_addr_tag, 0);
+			} else {
+				v->lru = c->num_cache_accesses;
+				cache_fill(c, block_addr_tag, 0);
+			}
+		} else {
+			// Cache Miss
+			hit = 0;
+
+			// Increment the miss counter
+			c->num_cache_misses++;
+
+			if (c->pf != NULL) {
+				struct prefetch_request *r = prefetch_inflight(c, block_addr_tag);
+				unsigned long *evicted = c->pollution_filter ? &c->pollution_filter[block_addr_tag % POLLUTION_FILTER_SIZE] : NULL;
 
-		// Increment the miss counter
-		c->num_cache_misses++;
+				// The prefetch was on its way, the demand access takes it over
+				if (r != NULL) {
+					c->num_prefetch_late++;
+					r->valid = 0;
+				}
+				if (evicted != NULL && *evicted == block_addr_tag + 1) {
+					c->num_prefetch_polluting++;
+					*evicted = 0;
+				}
+			}
 
-		// Bring the new block into the cache:
-		// Update the line's tag and mark it as valid.
-		line->valid = 1;
-		line->tag = block_addr_tag;
+			// Bring the new block into the cache:
+			// Update the line's tag and mark it as valid.
+			cache_fill(c, block_addr_tag, 0);
+			// A miss cache keeps a copy of every line fetched on a miss
+			if (c->num_victims > 0 && c->victim_mode == MISS_CACHE) {
+				victim_insert(c, block_addr_tag);
+			}
+		}
 	}
+
+	if (c->pf != NULL) prefetch_issue(c, pc, mem_addr, hit);
+
+	return hit;
+}
+
+
+int cache_access_pc(struct cache *c, unsigned long pc, unsigned long mem_addr) {
+	// Basic validation
+	if (c == NULL || c->tags == NULL) {
+		fprintf(stderr, "Error: cache_access called on an uninitialized or invalid cache.\n");
+		return 0;
+	}
+	if (c->num_shards > 0) {
+		// The outcome is only known once the shard's thread gets to it
+		cache_shard_access(c, mem_addr);
+		return -1;
+	}
+	if (c->access != NULL) {
+		return c->access(c, mem_addr);
+	}
+	return cache_access_generic(c, pc, mem_addr);
+}
+
+
+int cache_access_evict(struct cache *c, unsigned long pc, unsigned long mem_addr, unsigned long *evicted) {
+	int hit;
+
+	if (c == NULL || c->tags == NULL || c->num_shards > 0) {
+		fprintf(stderr, "Error: cache_access_evict called on an invalid or sharded cache.\n");
+		return 0;
+	}
+	// Only the generic path records evictions
+	c->last_evicted = 0;
+	hit = cache_access_generic(c, pc, mem_addr);
+	*evicted = c->last_evicted ? (c->last_evicted - 1) * CACHE_BLOCK_SIZE : CACHE_NO_EVICTION;
+
+	return hit;
+}
+
+
+int cache_access_ways(struct cache *c, unsigned long pc, unsigned long mem_addr, unsigned long way_mask) {
+	unsigned long all = c == NULL || c->num_ways == CACHE_WAYS_MAX ? ~0UL : (1UL << c->num_ways) - 1;
+	int hit;
+
+	if (c == NULL || c->tags == NULL || c->num_shards > 0 || (way_mask & all) == 0) {
+		fprintf(stderr, "Error: cache_access_ways called on an invalid or sharded cache, or with no ways.\n");
+		return 0;
+	}
+	// Only the generic path honors the mask
+	c->fill_mask = way_mask & all;
+	hit = cache_access_generic(c, pc, mem_addr);
+	c->fill_mask = 0;
+
+	return hit;
+}
+
+
+unsigned long cache_ways(struct cache *c) {
+	return c == NULL ? 0 : c->num_ways;
+}
+
+
+int cache_invalidate(struct cache *c, unsigned long mem_addr) {
+	unsigned long block = mem_addr / CACHE_BLOCK_SIZE;
+	unsigned long set;
+	long way;
+
+	if (c == NULL || c->tags == NULL || c->num_shards > 0) return 0;
+	set = block % c->num_sets;
+	way = cache_lookup(c, set, block);
+	if (way < 0) return 0;
+	c->valid[set] &= ~(1UL << way);
+	c->prefetched[set] &= ~(1UL << way);
+
+	return 1;
+}
+
+
+void cache_stats_reset(struct cache *c) {
+	if (c == NULL) return;
+	if (c->num_shards > 0) {
+		cache_shards_sync(c);
+		for (unsigned long i = 0; i < c->num_shards; i++) {
+			cache_stats_reset(c->shards[i].c);
+		}
+		return;
+	}
+	c->num_cache_accesses = c->num_cache_misses = 0;
+	c->num_prefetches = c->num_prefetch_useful = c->num_prefetch_late = c->num_prefetch_polluting = 0;
+	c->num_victim_hits = 0;
 }
 
 
 struct cache_stats cache_statistics(struct cache *c) {
-	// Handle case where cache might be NULL 
+	// Handle case where cache might be NULL
 	if (c == NULL) {
 		// Return zeroed statistics as a default
 		return (struct cache_stats){ .num_cache_accesses = 0, .num_cache_misses = 0 };
 	}
 
+	// A sharded cache's statistics are the sum of its shards'
+	if (c->num_shards > 0) {
+		struct cache_stats stats = { 0 };
+
+		cache_shards_sync(c);
+		for (unsigned long i = 0; i < c->num_shards; i++) {
+			struct cache_stats s = cache_statistics(c->shards[i].c);
+
+			stats.num_cache_accesses += s.num_cache_accesses;
+			stats.num_cache_misses += s.num_cache_misses;
+		}
+		return stats;
+	}
+
 	struct cache_stats stats;
 	stats.num_cache_accesses = c->num_cache_accesses;
 	stats.num_cache_misses = c->num_cache_misses;
+	stats.num_prefetches = c->num_prefetches;
+	stats.num_prefetch_useful = c->num_prefetch_useful;
+	stats.num_prefetch_late = c->num_prefetch_late;
+	stats.num_prefetch_polluting = c->num_prefetch_polluting;
+	stats.num_victim_hits = c->num_victim_hits;
 	return stats;
-}
\ No newline at end of file
+}
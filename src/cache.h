@@ -1,9 +1,11 @@
 #pragma once
 
-/* DO NOT MODIFY THIS FILE */
-
 /* Define this as you'd like in your .c file. */
 struct cache;
+struct prefetcher;
+
+/* Cache line size in bytes */
+#define CACHE_BLOCK_SIZE 64
 
 /* 
  * Emulate the behavior of a cache by tracking cache accesses and misses. You do not need to store values
@@ -18,10 +20,118 @@ struct cache;
  */
 void cache_access(struct cache *c, unsigned long mem_addr);
 
+/*
+ * Same as `cache_access`, but also tells the cache which load/store made the access. This
+ * is what PC-indexed models (such as the stride prefetcher) need.
+ *
+ * @param c The cache structure to operate on.
+ * @param pc The address of the instruction making the access.
+ * @param mem_addr The memory address to access in the cache.
+ * @return 1 if the access hit, 0 if it missed, and -1 if the cache is split between threads
+ *         (see `cache_set_threads`) so the outcome isn't known yet.
+ */
+int cache_access_pc(struct cache *c, unsigned long pc, unsigned long mem_addr);
+
+/* `cache_access_evict` reports this when the access evicted no line */
+#define CACHE_NO_EVICTION (~0UL)
+
+/*
+ * Same as `cache_access_pc`, but also report the line the access evicted to make room, so
+ * that a model built on top of the cache (e.g. coherence) can follow its contents.
+ *
+ * @param evicted Set to the address of the first byte of the evicted line, or to
+ *        `CACHE_NO_EVICTION`.
+ * @return 1 if the access hit, 0 if it missed.
+ */
+int cache_access_evict(struct cache *c, unsigned long pc, unsigned long mem_addr, unsigned long *evicted);
+
+/*
+ * Same as `cache_access_pc`, for an owner confined to some of the ways (like Intel's CAT):
+ * the access hits in any way, but a miss only replaces a line in the ways of `way_mask`.
+ *
+ * @param way_mask Bit w set if the access may fill way w, ~0 for all of them.
+ * @return 1 if the access hit, 0 if it missed.
+ */
+int cache_access_ways(struct cache *c, unsigned long pc, unsigned long mem_addr, unsigned long way_mask);
+
+/* The number of ways per set of a cache, the bits a way mask can use */
+unsigned long cache_ways(struct cache *c);
+
+/*
+ * Drop the line holding an address from the cache, if it is there.
+ *
+ * @return 1 if the line was in the cache, 0 otherwise.
+ */
+int cache_invalidate(struct cache *c, unsigned long mem_addr);
+
+/*
+ * Attach a prefetcher (see prefetch.h) to a cache. The cache takes ownership of it, and
+ * frees it in `cache_free`.
+ *
+ * @param c The cache the prefetcher observes and fills.
+ * @param pf The prefetcher, or NULL to detach.
+ * @param latency How many cache accesses it takes for a prefetch to arrive. A demand
+ *        access to a line that is still in flight counts as a late prefetch (and a miss).
+ */
+void cache_set_prefetcher(struct cache *c, struct prefetcher *pf, unsigned long latency);
+
+/*
+ * A small fully-associative buffer (Jouppi, 1990) behind the cache. A victim cache holds the
+ * lines the cache evicts, a miss cache holds a copy of every line the cache missed on. A
+ * demand access that misses in the cache but hits in the buffer is not counted as a miss.
+ */
+enum victim_mode {
+	VICTIM_CACHE,
+	MISS_CACHE,
+};
+
+/*
+ * Attach a victim or miss cache to a cache.
+ *
+ * @param c The cache the buffer sits behind.
+ * @param num_entries The number of lines in the buffer, 0 to detach it.
+ * @param mode Whether it is a victim cache or a miss cache.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int cache_set_victim(struct cache *c, unsigned long num_entries, enum victim_mode mode);
+
+/*
+ * Split the simulation of a cache between worker threads. Each thread owns a contiguous range
+ * of the sets and simulates, in order, the accesses that map to them; `cache_access` only
+ * queues the access for its set's thread. `cache_statistics` waits for the threads to catch
+ * up, and merges their counters. Prefetchers and victim caches look across sets, so a
+ * cache with either attached can't be split.
+ *
+ * @param c The cache, which must not have been accessed yet.
+ * @param num_threads The number of threads, at most one per set. 0 or 1 keeps the
+ *        simulation on the caller's thread.
+ * @return 0 on success, -1 on error.
+ */
+int cache_set_threads(struct cache *c, unsigned long num_threads);
+
 struct cache_stats {
 	unsigned long num_cache_accesses, num_cache_misses;
+	/*
+	 * Prefetches sent to memory, prefetched lines later hit by a demand access,
+	 * demand accesses to lines still in flight, and demand misses to lines that a
+	 * prefetch had evicted.
+	 */
+	unsigned long num_prefetches, num_prefetch_useful, num_prefetch_late, num_prefetch_polluting;
+	/* Misses in the cache that the victim/miss cache caught */
+	unsigned long num_victim_hits;
 };
 struct cache_stats cache_statistics(struct cache *c);
 
+/*
+ * Zero the statistics of a cache, keeping its contents: what follows is measured warm.
+ *
+ * @param c The cache.
+ */
+void cache_stats_reset(struct cache *c);
+
+/*
+ * Allocate a cache of `num_cache_lines` lines split evenly into `num_sets` sets, with LRU
+ * replacement within a set. `num_cache_lines == num_sets` gives a direct-mapped cache.
+ */
 struct cache *cache_allocate(unsigned long num_cache_lines, unsigned long num_sets);
 void cache_free(struct cache *c);
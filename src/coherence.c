@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "coherence.h"
+#include "cache.h"
+
+// Initial number of directory slots, a power of two
+#define DIRECTORY_INIT_SIZE 4096
+// Lines listed in the report
+#define COHERENCE_TOP_LINES 10
+
+// What the directory knows about one line
+struct dir_entry {
+	unsigned long block;     // Block address + 1, 0 marks a free slot
+	unsigned long sharers;   // Bit c is set if core c's private cache holds the line
+	int owner;               // Core holding it dirty (Modified, or Owned with sharers), -1 if none
+	int exclusive;           // The only holder got it Exclusive (or Modified): no upgrade needed
+	unsigned long num_invalidations;
+	unsigned long *written;  // Per core, a mask of the bytes it wrote, NULL until a store
+};
+
+struct core_stats {
+	unsigned long num_accesses, num_misses, num_invalidated;
+};
+
+struct coherence {
+	enum coherence_protocol protocol;
+	unsigned long num_cores;
+	struct cache **caches;            // The private cache of each core
+	struct core_stats *cores;
+	struct dir_entry *dir;            // Open addressing with linear probing
+	unsigned long dir_size, dir_count;
+	struct coherence_stats stats;
+};
+
+
+int coherence_protocol_parse(const char *name) {
+	if (strcmp(name, "mesi") == 0) return COHERENCE_MESI;
+	if (strcmp(name, "moesi") == 0) return COHERENCE_MOESI;
+	return -1;
+}
+
+
+struct coherence *coherence_alloc(enum coherence_protocol protocol, unsigned long num_cores,
+				  unsigned long num_cache_lines, unsigned long num_sets) {
+	struct coherence *co;
+
+	if (num_cores == 0 || num_cores > COHERENCE_CORES_MAX) {
+		fprintf(stderr, "Error: Coherence needs between 1 and %d cores.\n", COHERENCE_CORES_MAX);
+		return NULL;
+	}
+	co = (struct coherence *)calloc(1, sizeof(struct coherence));
+	if (co == NULL) {
+		perror("Failed to allocate coherence model");
+		return NULL;
+	}
+	co->protocol = protocol;
+	co->num_cores = num_cores;
+	co->dir_size = DIRECTORY_INIT_SIZE;
+	co->caches = (struct cache **)calloc(num_cores, sizeof(struct cache *));
+	co->cores = (struct core_stats *)calloc(num_cores, sizeof(struct core_stats));
+	co->dir = (struct dir_entry *)calloc(co->dir_size, sizeof(struct dir_entry));
+	if (co->caches == NULL || co->cores == NULL || co->dir == NULL) {
+		perror("Failed to allocate coherence model");
+		coherence_free(co);
+		return NULL;
+	}
+	for (unsigned long c = 0; c < num_cores; c++) {
+		co->caches[c] = cache_allocate(num_cache_lines, num_sets);
+		if (co->caches[c] == NULL) {
+			coherence_free(co);
+			return NULL;
+		}
+	}
+
+	return co;
+}
+
+
+void coherence_free(struct coherence *co) {
+	if (co == NULL) return;
+	for (unsigned long c = 0; co->caches && c < co->num_cores; c++) {
+		cache_free(co->caches[c]);
+	}
+	for (unsigned long i = 0; co->dir && i < co->dir_size; i++) {
+		free(co->dir[i].written);
+	}
+	free(co->caches);
+	free(co->cores);
+	free(co->dir);
+	free(co);
+}
+
+
+static struct dir_entry *dir_slot(struct dir_entry *dir, unsigned long size, unsigned long block) {
+	unsigned long i = (block * 0x9e3779b97f4a7c15UL) & (size - 1);
+
+	while (dir[i].block != 0 && dir[i].block != block + 1) {
+		i = (i + 1) & (size - 1);
+	}
+	return &dir[i];
+}
+
+
+// Double the directory when it is half full
+static int dir_grow(struct coherence *co) {
+	unsigned long size = co->dir_size * 2;
+	struct dir_entry *dir = (struct dir_entry *)calloc(size, sizeof(struct dir_entry));
+
+	if (dir == NULL) {
+		perror("Failed to grow coherence directory");
+		return -1;
+	}
+	for (unsigned long i = 0; i < co->dir_size; i++) {
+		if (co->dir[i].block != 0) *dir_slot(dir, size, co->dir[i].block - 1) = co->dir[i];
+	}
+	free(co->dir);
+	co->dir = dir;
+	co->dir_size = size;
+
+	return 0;
+}
+
+
+// The directory entry of a line, created (not held by anyone) if it is new
+static struct dir_entry *dir_lookup(struct coherence *co, unsigned long block) {
+	struct dir_entry *e = dir_slot(co->dir, co->dir_size, block);
+
+	if (e->block == 0) {
+		if (co->dir_count + 1 > co->dir_size / 2) {
+			if (dir_grow(co) != 0) return NULL;
+			e = dir_slot(co->dir, co->dir_size, block);
+		}
+		e->block = block + 1;
+		e->owner = -1;
+		co->dir_count++;
+	}
+	return e;
+}
+
+
+// Every copy but `core`'s is invalidated
+static void invalidate_others(struct coherence *co, struct dir_entry *e, unsigned int core) {
+	unsigned long others = e->sharers & ~(1UL << core);
+
+	while (others) {
+		unsigned int c = __builtin_ctzl(others);
+
+		others &= others - 1;
+		cache_invalidate(co->caches[c], (e->block - 1) * CACHE_BLOCK_SIZE);
+		co->cores[c].num_invalidated++;
+		co->stats.num_invalidations++;
+		e->num_invalidations++;
+	}
+	e->sharers &= 1UL << core;
+}
+
+
+// A core's private cache evicted a line: it gives up its copy, writing it back if dirty
+static void coherence_evict(struct coherence *co, unsigned int core, unsigned long block) {
+	struct dir_entry *e = dir_lookup(co, block);
+
+	if (e == NULL) return;
+	e->sharers &= ~(1UL << core);
+	if (e->owner == (int)core) {
+		co->stats.num_writebacks++;
+		e->owner = -1;
+	}
+}
+
+
+void coherence_access(struct coherence *co, unsigned int core, unsigned long mem_addr, unsigned long size, int is_store) {
+	unsigned long block = mem_addr / CACHE_BLOCK_SIZE, bit = 1UL << core, evicted;
+	struct dir_entry *e;
+	int hit;
+
+	if (co == NULL || core >= co->num_cores) return;
+	co->stats.num_accesses++;
+	co->cores[core].num_accesses++;
+	hit = cache_access_evict(co->caches[core], 0, mem_addr, &evicted);
+	if (evicted != CACHE_NO_EVICTION) coherence_evict(co, core, evicted / CACHE_BLOCK_SIZE);
+	if (!hit) {
+		co->stats.num_misses++;
+		co->cores[core].num_misses++;
+	}
+	if ((e = dir_lookup(co, block)) == NULL) return;
+
+	if (!is_store) {
+		if (hit) return;
+		// Read miss: a dirty copy elsewhere supplies the data
+		if (e->owner >= 0) {
+			co->stats.num_transfers++;
+			// MESI: Modified -> Shared, writing the line back. MOESI: Modified -> Owned.
+			if (co->protocol == COHERENCE_MESI) {
+				co->stats.num_writebacks++;
+				e->owner = -1;
+			}
+		}
+		e->exclusive = e->sharers == 0;
+		e->sharers |= bit;
+		return;
+	}
+
+	if (hit) {
+		// Modified and Exclusive copies are written without telling anyone
+		if (!(e->sharers == bit && (e->owner == (int)core || e->exclusive))) {
+			co->stats.num_upgrades++;
+			invalidate_others(co, e, core);
+		}
+	} else {
+		// Read for ownership
+		if (e->owner >= 0) co->stats.num_transfers++;
+		invalidate_others(co, e, core);
+	}
+	e->sharers = bit;
+	e->owner = core;
+	e->exclusive = 1;
+
+	// Remember which bytes of the line this core wrote
+	if (e->written == NULL) {
+		e->written = (unsigned long *)calloc(co->num_cores, sizeof(unsigned long));
+		if (e->written == NULL) return;
+	}
+	unsigned long off = mem_addr % CACHE_BLOCK_SIZE;
+	unsigned long len = off + size > CACHE_BLOCK_SIZE ? CACHE_BLOCK_SIZE - off : size;
+
+	e->written[core] |= (len >= 64 ? ~0UL : (1UL << len) - 1) << off;
+}
+
+
+// 1 if several cores wrote the line, 2 if moreover none of their bytes overlap
+static int line_sharing(struct coherence *co, struct dir_entry *e) {
+	unsigned long all = 0, writers = 0;
+	int overlap = 0;
+
+	if (e->written == NULL) return 0;
+	for (unsigned long c = 0; c < co->num_cores; c++) {
+		if (e->written[c] == 0) continue;
+		writers++;
+		if (all & e->written[c]) overlap = 1;
+		all |= e->written[c];
+	}
+	if (writers < 2) return 0;
+	return overlap ? 1 : 2;
+}
+
+
+struct coherence_stats coherence_statistics(struct coherence *co) {
+	struct coherence_stats s;
+
+	if (co == NULL) return (struct coherence_stats){ 0 };
+	s = co->stats;
+	for (unsigned long i = 0; i < co->dir_size; i++) {
+		int sharing;
+
+		if (co->dir[i].block == 0) continue;
+		sharing = line_sharing(co, &co->dir[i]);
+		if (sharing >= 1) s.num_shared_written_lines++;
+		if (sharing == 2) s.num_false_shared_lines++;
+	}
+	return s;
+}
+
+
+void coherence_stats_reset(struct coherence *co) {
+	if (co == NULL) return;
+	co->stats = (struct coherence_stats){ 0 };
+	for (unsigned long c = 0; c < co->num_cores; c++) {
+		co->cores[c] = (struct core_stats){ 0 };
+		cache_stats_reset(co->caches[c]);
+	}
+	for (unsigned long i = 0; i < co->dir_size; i++) {
+		struct dir_entry *e = &co->dir[i];
+
+		if (e->block == 0) continue;
+		e->num_invalidations = 0;
+		if (e->written) memset(e->written, 0, co->num_cores * sizeof(unsigned long));
+	}
+}
+
+
+static int entry_cmp(const void *a, const void *b) {
+	const struct dir_entry *x = *(const struct dir_entry **)a, *y = *(const struct dir_entry **)b;
+
+	if (x->num_invalidations != y->num_invalidations) return x->num_invalidations > y->num_invalidations ? -1 : 1;
+	return x->block < y->block ? -1 : (x->block > y->block);
+}
+
+
+void coherence_print(struct coherence *co) {
+	struct coherence_stats s = coherence_statistics(co);
+	struct dir_entry **lines;
+	unsigned long n = 0;
+
+	if (co == NULL) return;
+	printf("Coherence: %s, Cores: %lu\n", co->protocol == COHERENCE_MESI ? "MESI" : "MOESI", co->num_cores);
+	printf("Accesses: %lu, Misses: %lu, Invalidations: %lu, Upgrades: %lu, Cache-to-Cache Transfers: %lu, Writebacks: %lu\n",
+		s.num_accesses, s.num_misses, s.num_invalidations, s.num_upgrades, s.num_transfers, s.num_writebacks);
+	printf("Lines Written by Several Cores: %lu, Falsely Shared: %lu\n",
+		s.num_shared_written_lines, s.num_false_shared_lines);
+	printf("%6s %14s %14s %10s %14s\n", "Core", "Accesses", "Misses", "Hit Rate", "Invalidated");
+	for (unsigned long c = 0; c < co->num_cores; c++) {
+		struct core_stats *cs = &co->cores[c];
+
+		printf("%6lu %14lu %14lu %9.2f%% %14lu\n", c, cs->num_accesses, cs->num_misses,
+			cs->num_accesses == 0 ? 0.0 :
+			(((double)cs->num_accesses - (double)cs->num_misses) / (double)cs->num_accesses) * 100.0,
+			cs->num_invalidated);
+	}
+
+	// The lines that bounce between cores the most
+	lines = (struct dir_entry **)malloc(co->dir_count * sizeof(struct dir_entry *) + 1);
+	if (lines == NULL) {
+		perror("Failed to sort coherence lines");
+		return;
+	}
+	for (unsigned long i = 0; i < co->dir_size; i++) {
+		if (co->dir[i].block != 0 && co->dir[i].num_invalidations > 0) lines[n++] = &co->dir[i];
+	}
+	qsort(lines, n, sizeof(struct dir_entry *), entry_cmp);
+	if (n > COHERENCE_TOP_LINES) n = COHERENCE_TOP_LINES;
+	if (n > 0) {
+		printf("Most Invalidated Lines:\n");
+		printf("%18s %14s  %s\n", "Line", "Invalidations", "Sharing");
+	}
+	for (unsigned long i = 0; i < n; i++) {
+		char *sharing[] = { "single writer", "true sharing", "FALSE SHARING" };
+
+		printf("%#18lx %14lu  %s\n", (lines[i]->block - 1) * CACHE_BLOCK_SIZE, lines[i]->num_invalidations,
+			sharing[line_sharing(co, lines[i])]);
+	}
+	free(lines);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+/*
+ * Private per-core caches kept coherent by a directory-based MESI or MOESI protocol. Each
+ * core has its own `struct cache` (see cache.h) that decides hits, misses and evictions,
+ * and a directory records, for every line, which cores hold a copy and which one owns it:
+ *
+ * - A load miss gets the line from the core holding it dirty (a cache-to-cache transfer),
+ *   or from memory. Under MESI the dirty copy is written back and both become Shared;
+ *   under MOESI the owner keeps it in the Owned state. A line no one else holds is loaded
+ *   Exclusive.
+ * - A store to a Shared or Owned line is an upgrade, which invalidates the other copies.
+ *   A store to an Exclusive line silently makes it Modified. A store miss invalidates every
+ *   other copy, and takes the dirty data from its owner if there is one.
+ * - A dirty (Modified or Owned) line evicted from a private cache is written back.
+ *
+ * For false-sharing detection, the bytes each core writes to each line are tracked. A line
+ * written by several cores, none of which wrote a byte another one wrote, only moves
+ * between them because of how the data is laid out: it is falsely shared.
+ */
+
+/* The most cores a directory entry can track */
+#define COHERENCE_CORES_MAX 64
+
+enum coherence_protocol {
+	COHERENCE_MESI,
+	COHERENCE_MOESI,
+};
+
+struct coherence_stats {
+	unsigned long num_accesses, num_misses;
+	/* Copies invalidated by another core's store, and stores to Shared/Owned lines */
+	unsigned long num_invalidations, num_upgrades;
+	/* Misses served by another core's dirty copy, and dirty lines written to memory */
+	unsigned long num_transfers, num_writebacks;
+	/* Lines written by several cores, and those of them that are falsely shared */
+	unsigned long num_shared_written_lines, num_false_shared_lines;
+};
+
+/* Define this as you'd like in your .c file. */
+struct coherence;
+
+/*
+ * Allocate the private caches and their directory.
+ *
+ * @param protocol MESI or MOESI.
+ * @param num_cores The number of cores, at most COHERENCE_CORES_MAX.
+ * @param num_cache_lines The number of lines of each private cache.
+ * @param num_sets The number of sets of each private cache.
+ * @return The model, or NULL on error.
+ */
+struct coherence *coherence_alloc(enum coherence_protocol protocol, unsigned long num_cores,
+				  unsigned long num_cache_lines, unsigned long num_sets);
+void coherence_free(struct coherence *co);
+
+/*
+ * Send one load/store of a core through its private cache and the protocol.
+ *
+ * @param co The model.
+ * @param core The core making the access, accesses of cores beyond the last are ignored.
+ * @param mem_addr The address accessed.
+ * @param size The number of bytes accessed, within one line.
+ * @param is_store 1 for a store, 0 for a load.
+ */
+void coherence_access(struct coherence *co, unsigned int core, unsigned long mem_addr, unsigned long size, int is_store);
+
+struct coherence_stats coherence_statistics(struct coherence *co);
+
+/* Parse "mesi" or "moesi", -1 if it is neither */
+int coherence_protocol_parse(const char *name);
+
+/* Zero the statistics, per core and per line, keeping the private caches' contents and the directory */
+void coherence_stats_reset(struct coherence *co);
+
+/* Print the protocol's statistics, per core, and the lines with the most invalidations */
+void coherence_print(struct coherence *co);
@@ -30,6 +30,7 @@ int processor_emulate_cntlflowops(struct processor *p, struct instruction *instr
     // Instruction is handled here
     reg_t current_pc = registers_getpc(p->rs);
     reg_t next_pc = current_pc + 4; // Default next PC
+    int taken = 0; // Whether a branch is taken
 
     // Define variables for operands
     u64_t rs1_val_u = 0, rs2_val_u = 0;
@@ -111,31 +112,37 @@ int processor_emulate_cntlflowops(struct processor *p, struct instruction *instr
         // Branch Instructions
         case BEQ: 
             if (rs1_val_u == rs2_val_u) {
+                taken = 1;
                 next_pc = current_pc + imm;
             }
             break;
         case BNE: 
             if (rs1_val_u != rs2_val_u) {
+                taken = 1;
                 next_pc = current_pc + imm;
             }
             break;
         case BLT:
             if (rs1_val_s < rs2_val_s) {
+                taken = 1;
                 next_pc = current_pc + imm;
             }
             break;
         case BGE:
             if (rs1_val_s >= rs2_val_s) {
+                taken = 1;
                 next_pc = current_pc + imm;
             }
             break;
         case BLTU:
             if (rs1_val_u < rs2_val_u) {
+                taken = 1;
                 next_pc = current_pc + imm;
             }
             break;
         case BGEU: 
             if (rs1_val_u >= rs2_val_u) {
+                taken = 1;
                 next_pc = current_pc + imm;
             }
             break;
@@ -170,6 +177,9 @@ int processor_emulate_cntlflowops(struct processor *p, struct instruction *instr
             break;
     }
 
+    // Let the branch predictors guess the outcome, then learn it
+    if (p->bpred && p->measuring) bpred_branch(p->bpred, instr, taken, next_pc);
+
     // Update Program Counter 
     registers_setpc(p->rs, next_pc);
 
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "cosched.h"
+#include "cache.h"
+
+// Each program's addresses are tagged with its number in these bits, above any program's memory
+#define COSCHED_PROGRAM_SHIFT 48
+
+struct program_stat {
+	unsigned long accesses;
+	unsigned long alone_misses, shared_misses, partitioned_misses;
+};
+
+struct cosched {
+	struct cosched_config cfg;
+	struct cache *alone[COSCHED_PROGRAMS_MAX];
+	struct cache *shared, *partitioned; // partitioned is NULL without masks
+	struct program_stat stats[COSCHED_PROGRAMS_MAX];
+};
+
+
+struct cosched *cosched_alloc(struct cosched_config *cfg) {
+	struct cosched *cs;
+	int partitioned = 0;
+
+	if (cfg->num_programs == 0 || cfg->num_programs > COSCHED_PROGRAMS_MAX) {
+		fprintf(stderr, "Error: Between 1 and %d programs can be co-scheduled.\n", COSCHED_PROGRAMS_MAX);
+		return NULL;
+	}
+	cs = (struct cosched *)calloc(1, sizeof(struct cosched));
+	if (cs == NULL) {
+		perror("Failed to allocate shared cache");
+		return NULL;
+	}
+	cs->cfg = *cfg;
+	for (unsigned long i = 0; i < cfg->num_programs; i++) {
+		if (cfg->way_masks[i] != 0) partitioned = 1;
+		if (!(cs->alone[i] = cache_allocate(cfg->cache_lines, cfg->cache_sets))) goto err;
+	}
+	if (!(cs->shared = cache_allocate(cfg->cache_lines, cfg->cache_sets))) goto err;
+	if (partitioned) {
+		unsigned long ways = cache_ways(cs->shared);
+		unsigned long all = ways >= 64 ? ~0UL : (1UL << ways) - 1;
+
+		for (unsigned long i = 0; i < cfg->num_programs; i++) {
+			if ((cfg->way_masks[i] & all) == 0 || (cfg->way_masks[i] & ~all) != 0) {
+				fprintf(stderr, "Error: Each program needs a way mask within the %lu ways of the shared cache.\n", ways);
+				goto err;
+			}
+		}
+		if (!(cs->partitioned = cache_allocate(cfg->cache_lines, cfg->cache_sets))) goto err;
+	}
+
+	return cs;
+err:
+	cosched_free(cs);
+	return NULL;
+}
+
+
+void cosched_free(struct cosched *cs) {
+	if (cs == NULL) return;
+	for (unsigned long i = 0; i < COSCHED_PROGRAMS_MAX; i++) {
+		cache_free(cs->alone[i]);
+	}
+	cache_free(cs->shared);
+	cache_free(cs->partitioned);
+	free(cs);
+}
+
+
+void cosched_access(struct cosched *cs, unsigned long program, unsigned long pc, unsigned long mem_addr) {
+	struct program_stat *s = &cs->stats[program];
+	unsigned long addr = (program << COSCHED_PROGRAM_SHIFT) | mem_addr;
+
+	s->accesses++;
+	if (cache_access_pc(cs->alone[program], pc, addr) == 0) s->alone_misses++;
+	if (cache_access_pc(cs->shared, pc, addr) == 0) s->shared_misses++;
+	if (cs->partitioned && cache_access_ways(cs->partitioned, pc, addr, cs->cfg.way_masks[program]) == 0) {
+		s->partitioned_misses++;
+	}
+}
+
+
+static double rate(unsigned long misses, unsigned long accesses) {
+	return accesses == 0 ? 0.0 : ((double)misses / (double)accesses) * 100.0;
+}
+
+
+void cosched_print(struct cosched *cs, unsigned long *num_instrs) {
+	struct program_stat total = { 0 };
+	unsigned long instrs = 0;
+	char mask[32];
+
+	if (cs == NULL) return;
+	printf("Co-Scheduling: %lu programs, %lu instructions per turn, Shared Cache: %lu lines, %lu sets\n",
+		cs->cfg.num_programs, cs->cfg.quantum, cs->cfg.cache_lines, cs->cfg.cache_sets);
+	printf("%8s %10s %14s %14s %12s %12s %12s\n", "Program", "Ways", "Instructions", "Accesses", "Alone", "Shared", "Partitioned");
+	for (unsigned long i = 0; i <= cs->cfg.num_programs; i++) {
+		struct program_stat *s = i < cs->cfg.num_programs ? &cs->stats[i] : &total;
+
+		if (i < cs->cfg.num_programs) {
+			instrs += num_instrs[i];
+			total.accesses += s->accesses;
+			total.alone_misses += s->alone_misses;
+			total.shared_misses += s->shared_misses;
+			total.partitioned_misses += s->partitioned_misses;
+			if (cs->partitioned) snprintf(mask, sizeof(mask), "%#lx", cs->cfg.way_masks[i]);
+			else                 snprintf(mask, sizeof(mask), "all");
+			printf("%8lu %10s %14lu", i, mask, num_instrs[i]);
+		} else {
+			printf("%8s %10s %14lu", "total", "", instrs);
+		}
+		printf(" %14lu %11.2f%% %11.2f%%", s->accesses, rate(s->alone_misses, s->accesses), rate(s->shared_misses, s->accesses));
+		if (cs->partitioned) printf(" %11.2f%%\n", rate(s->partitioned_misses, s->accesses));
+		else                 printf(" %12s\n", "-");
+	}
+	printf("Misses: Alone: %lu, Shared: %lu (%+ld from interference)", total.alone_misses, total.shared_misses,
+		(long)total.shared_misses - (long)total.alone_misses);
+	if (cs->partitioned) {
+		printf(", Partitioned: %lu (%+ld)", total.partitioned_misses, (long)total.partitioned_misses - (long)total.alone_misses);
+	}
+	printf("\n");
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+/* Most programs co-scheduled in one run */
+#define COSCHED_PROGRAMS_MAX 16
+
+/*
+ * The last-level cache shared by co-scheduled programs. Each program has its own registers,
+ * memory and private L1 cache, and the misses of its L1 come here. The programs' addresses
+ * overlap, so each one's are tagged with its number: they never share lines.
+ *
+ * The same misses go, side by side, to three versions of the shared cache:
+ *
+ * - alone: a copy of the cache per program, seeing only its own misses, as if it ran by itself;
+ * - shared: one cache all the programs fill freely, where they evict each other's lines;
+ * - partitioned: one cache where each program only fills the ways of its mask (like Intel's
+ *   Cache Allocation Technology), if masks are given.
+ *
+ * The extra misses in the shared cache over running alone are the interference between the
+ * programs, and the partitioned cache shows how much of it the masks remove.
+ */
+
+struct cosched_config {
+	unsigned long num_programs;
+	unsigned long cache_lines, cache_sets;              // The shared cache's geometry
+	unsigned long quantum;                              // Instructions each program runs per turn
+	unsigned long way_masks[COSCHED_PROGRAMS_MAX];      // The ways each program fills, none if all 0
+};
+
+/* Define this as you'd like in your .c file. */
+struct cosched;
+
+struct cosched *cosched_alloc(struct cosched_config *cfg);
+void cosched_free(struct cosched *cs);
+
+/*
+ * A miss in a program's L1, sent to the shared cache.
+ *
+ * @param cs The shared cache.
+ * @param program The program that missed.
+ * @param pc The address of its load/store.
+ * @param mem_addr The address accessed, in the program's memory.
+ */
+void cosched_access(struct cosched *cs, unsigned long program, unsigned long pc, unsigned long mem_addr);
+
+/*
+ * Print each program's instructions, accesses to the shared cache and miss rates alone,
+ * shared and partitioned, and the misses added by sharing.
+ *
+ * @param cs The shared cache.
+ * @param num_instrs The instructions each program executed.
+ */
+void cosched_print(struct cosched *cs, unsigned long *num_instrs);
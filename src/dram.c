@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dram.h"
+#include "cache.h"
+
+// No row open in a bank
+#define DRAM_NO_ROW (~0UL)
+
+struct dram_bank {
+	unsigned long open_row; // DRAM_NO_ROW if precharged
+	unsigned long ready;    // First cycle it can take a command
+};
+
+struct dram {
+	struct dram_config cfg;
+	struct dram_bank *banks;
+	unsigned long lines_per_row;
+	unsigned long bus_free;  // First cycle the data bus is free
+	unsigned long num_accesses, num_row_hits, num_row_misses, num_row_conflicts;
+	unsigned long total_latency, queue_cycles;
+};
+
+static const char *mapping_names[] = { "row:bank:column", "row:column:bank", "row:bank:column, xor" };
+
+
+int dram_policy_parse(const char *name) {
+	if (strcmp(name, "open") == 0) return DRAM_OPEN_PAGE;
+	if (strcmp(name, "closed") == 0) return DRAM_CLOSED_PAGE;
+	return -1;
+}
+
+
+int dram_mapping_parse(const char *name) {
+	if (strcmp(name, "rbc") == 0) return DRAM_MAP_RBC;
+	if (strcmp(name, "rcb") == 0) return DRAM_MAP_RCB;
+	if (strcmp(name, "xor") == 0) return DRAM_MAP_XOR;
+	return -1;
+}
+
+
+struct dram *dram_alloc(struct dram_config *cfg) {
+	struct dram *d;
+
+	if (cfg->banks == 0 || (cfg->banks & (cfg->banks - 1)) != 0) {
+		fprintf(stderr, "Error: The number of DRAM banks must be a power of two.\n");
+		return NULL;
+	}
+	if (cfg->row_size < CACHE_BLOCK_SIZE || (cfg->row_size & (cfg->row_size - 1)) != 0) {
+		fprintf(stderr, "Error: DRAM rows must be a power of two, and at least a cache line.\n");
+		return NULL;
+	}
+	d = (struct dram *)calloc(1, sizeof(struct dram));
+	if (d == NULL) {
+		perror("Failed to allocate DRAM");
+		return NULL;
+	}
+	d->cfg = *cfg;
+	d->lines_per_row = cfg->row_size / CACHE_BLOCK_SIZE;
+	d->banks = (struct dram_bank *)calloc(cfg->banks, sizeof(struct dram_bank));
+	if (d->banks == NULL) {
+		perror("Failed to allocate DRAM banks");
+		free(d);
+		return NULL;
+	}
+	for (unsigned long b = 0; b < cfg->banks; b++) {
+		d->banks[b].open_row = DRAM_NO_ROW;
+	}
+
+	return d;
+}
+
+
+void dram_free(struct dram *d) {
+	if (d == NULL) return;
+	free(d->banks);
+	free(d);
+}
+
+
+unsigned long dram_access(struct dram *d, unsigned long mem_addr, unsigned long t) {
+	unsigned long line = mem_addr / CACHE_BLOCK_SIZE, bank, row, start, column, data;
+	struct dram_bank *b;
+
+	if (d == NULL) return 0;
+	switch (d->cfg.mapping) {
+	case DRAM_MAP_RCB:
+		bank = line & (d->cfg.banks - 1);
+		row = line / d->cfg.banks / d->lines_per_row;
+		break;
+	default:
+		bank = (line / d->lines_per_row) & (d->cfg.banks - 1);
+		row = line / d->lines_per_row / d->cfg.banks;
+		if (d->cfg.mapping == DRAM_MAP_XOR) bank ^= row & (d->cfg.banks - 1);
+		break;
+	}
+	b = &d->banks[bank];
+
+	// Wait for the bank, then open the row if needed
+	start = t > b->ready ? t : b->ready;
+	if (b->open_row == row) {
+		d->num_row_hits++;
+		column = start;
+	} else if (b->open_row == DRAM_NO_ROW) {
+		d->num_row_misses++;
+		column = start + d->cfg.t_rcd;
+	} else {
+		d->num_row_conflicts++;
+		column = start + d->cfg.t_rp + d->cfg.t_rcd;
+	}
+	// The data comes out tCAS after the column access, once the bus is free
+	data = column + d->cfg.t_cas;
+	if (data < d->bus_free) data = d->bus_free;
+	d->bus_free = data + d->cfg.t_burst;
+
+	// The next column access to the row can follow a burst later, or, closing the page,
+	// the bank is precharged after this one
+	if (d->cfg.policy == DRAM_OPEN_PAGE) {
+		b->open_row = row;
+		b->ready = column + d->cfg.t_burst;
+	} else {
+		b->open_row = DRAM_NO_ROW;
+		b->ready = column + d->cfg.t_burst + d->cfg.t_rp;
+	}
+
+	d->num_accesses++;
+	d->queue_cycles += start - t;
+	d->total_latency += d->bus_free - t;
+
+	return d->bus_free - t;
+}
+
+
+void dram_stats_reset(struct dram *d) {
+	if (d == NULL) return;
+	d->num_accesses = d->num_row_hits = d->num_row_misses = d->num_row_conflicts = 0;
+	d->total_latency = d->queue_cycles = 0;
+}
+
+
+void dram_print(struct dram *d) {
+	if (d == NULL) return;
+	printf("DRAM: %lu banks, %lu-byte rows, %s page, %s, tRCD: %lu, tCAS: %lu, tRP: %lu, tBurst: %lu\n",
+		d->cfg.banks, d->cfg.row_size, d->cfg.policy == DRAM_OPEN_PAGE ? "open" : "closed",
+		mapping_names[d->cfg.mapping], d->cfg.t_rcd, d->cfg.t_cas, d->cfg.t_rp, d->cfg.t_burst);
+	printf("DRAM Accesses: %lu, Row Hits: %lu, Row Misses: %lu, Row Conflicts: %lu, Row Hit Rate: %.2f%%\n",
+		d->num_accesses, d->num_row_hits, d->num_row_misses, d->num_row_conflicts,
+		d->num_accesses == 0 ? 0.0 : ((double)d->num_row_hits / (double)d->num_accesses) * 100.0);
+	printf("DRAM Average Latency: %.2f cycles, Average Wait for a Busy Bank: %.2f cycles\n",
+		d->num_accesses == 0 ? 0.0 : (double)d->total_latency / (double)d->num_accesses,
+		d->num_accesses == 0 ? 0.0 : (double)d->queue_cycles / (double)d->num_accesses);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+/*
+ * DRAM behind the last cache level, fed its misses (one line each). Addresses are split into
+ * a bank, a row and a column according to the interleaving, and each bank keeps one row open
+ * in its row buffer:
+ *
+ * - a row hit (the row is open) only needs the column access, tCAS;
+ * - a row miss (no row open) activates the row first, tRCD;
+ * - a row conflict (another row is open) precharges the bank first, tRP, then activates.
+ *
+ * Under the open-page policy, a bank keeps its row open after an access; under the
+ * closed-page policy it precharges right away, so every access activates its row but never
+ * waits for a precharge. Accesses to a busy bank queue behind it, and the data of each
+ * access takes tBurst cycles on the one data bus. All the timings are in core cycles.
+ */
+
+enum dram_policy {
+	DRAM_OPEN_PAGE,
+	DRAM_CLOSED_PAGE,
+};
+
+enum dram_mapping {
+	DRAM_MAP_RBC,  // row:bank:column, consecutive lines fill a row, then move to the next bank
+	DRAM_MAP_RCB,  // row:column:bank, consecutive lines go to consecutive banks
+	DRAM_MAP_XOR,  // row:bank:column, with the bank xor-ed with the low bits of the row
+};
+
+struct dram_config {
+	unsigned long banks;     // Number of banks, a power of two
+	unsigned long row_size;  // Bytes in a row, a power of two and at least a cache line
+	unsigned long t_rcd, t_cas, t_rp, t_burst;
+	enum dram_policy policy;
+	enum dram_mapping mapping;
+};
+
+/* Define this as you'd like in your .c file. */
+struct dram;
+
+struct dram *dram_alloc(struct dram_config *cfg);
+void dram_free(struct dram *d);
+
+/*
+ * Read a line from the DRAM.
+ *
+ * @param d The DRAM.
+ * @param mem_addr An address in the line.
+ * @param t The cycle of the request.
+ * @return The cycles until the line arrived.
+ */
+unsigned long dram_access(struct dram *d, unsigned long mem_addr, unsigned long t);
+
+/* Parse an `enum dram_policy` ("open" or "closed") or `enum dram_mapping` ("rbc", "rcb" or "xor"), -1 if unknown */
+int dram_policy_parse(const char *name);
+int dram_mapping_parse(const char *name);
+
+/* Zero the access counts and latencies, keeping the open rows and the banks' timing */
+void dram_stats_reset(struct dram *d);
+
+/* Print the configuration, the row-buffer hits, misses and conflicts, and the average latency */
+void dram_print(struct dram *d);
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "heatmap.h"
+
+// Initial number of cells in an interval's table, a power of two
+#define HEATMAP_INIT_SIZE 256
+
+struct heatmap_cell {
+	unsigned long bin;      // Address / granularity
+	unsigned long accesses; // 0 marks a free slot
+	unsigned long misses;
+};
+
+struct heatmap {
+	FILE *f;
+	unsigned long interval, shift;
+	unsigned long cur;            // Index of the interval being collected
+	struct heatmap_cell *cells;   // Open addressing with linear probing
+	unsigned long size, count;    // Slots, and slots in use
+};
+
+
+static inline unsigned long bin_hash(unsigned long bin) {
+	return bin * 0x9e3779b97f4a7c15UL;
+}
+
+
+struct heatmap *heatmap_open(const char *path, unsigned long interval, unsigned long granularity) {
+	struct heatmap *h;
+
+	if (interval == 0 || granularity == 0 || (granularity & (granularity - 1)) != 0) {
+		fprintf(stderr, "Error: The heatmap needs an interval, and a power-of-two granularity.\n");
+		return NULL;
+	}
+	h = (struct heatmap *)calloc(1, sizeof(struct heatmap));
+	if (h == NULL) {
+		perror("Failed to allocate heatmap");
+		return NULL;
+	}
+	h->interval = interval;
+	h->shift = __builtin_ctzl(granularity);
+	h->size = HEATMAP_INIT_SIZE;
+	h->cells = (struct heatmap_cell *)calloc(h->size, sizeof(struct heatmap_cell));
+	if (h->cells == NULL) {
+		perror("Failed to allocate heatmap cells");
+		free(h);
+		return NULL;
+	}
+	h->f = fopen(path, "w");
+	if (h->f == NULL) {
+		perror("Failed to create heatmap file");
+		free(h->cells);
+		free(h);
+		return NULL;
+	}
+	fprintf(h->f, "interval,address,accesses,misses\n");
+
+	return h;
+}
+
+
+static struct heatmap_cell *heatmap_slot(struct heatmap_cell *cells, unsigned long size, unsigned long bin) {
+	unsigned long i = bin_hash(bin) & (size - 1);
+
+	while (cells[i].accesses != 0 && cells[i].bin != bin) {
+		i = (i + 1) & (size - 1);
+	}
+	return &cells[i];
+}
+
+
+static int cell_cmp(const void *a, const void *b) {
+	const struct heatmap_cell *x = (const struct heatmap_cell *)a, *y = (const struct heatmap_cell *)b;
+
+	return x->bin < y->bin ? -1 : (x->bin > y->bin);
+}
+
+
+// Write out the row of the current interval in address order, and empty the table
+static void heatmap_flush(struct heatmap *h) {
+	unsigned long n = 0;
+
+	if (h->count == 0) return;
+	// Pack the used cells at the front of the table to sort them
+	for (unsigned long i = 0; i < h->size; i++) {
+		if (h->cells[i].accesses != 0) h->cells[n++] = h->cells[i];
+	}
+	qsort(h->cells, n, sizeof(struct heatmap_cell), cell_cmp);
+	for (unsigned long i = 0; i < n; i++) {
+		fprintf(h->f, "%lu,%lu,%lu,%lu\n", h->cur * h->interval, h->cells[i].bin << h->shift,
+			h->cells[i].accesses, h->cells[i].misses);
+	}
+	memset(h->cells, 0, h->size * sizeof(struct heatmap_cell));
+	h->count = 0;
+}
+
+
+// Double the table when it is half full
+static int heatmap_grow(struct heatmap *h) {
+	unsigned long size = h->size * 2;
+	struct heatmap_cell *cells = (struct heatmap_cell *)calloc(size, sizeof(struct heatmap_cell));
+
+	if (cells == NULL) {
+		perror("Failed to grow heatmap");
+		return -1;
+	}
+	for (unsigned long i = 0; i < h->size; i++) {
+		if (h->cells[i].accesses != 0) *heatmap_slot(cells, size, h->cells[i].bin) = h->cells[i];
+	}
+	free(h->cells);
+	h->cells = cells;
+	h->size = size;
+
+	return 0;
+}
+
+
+void heatmap_record(struct heatmap *h, unsigned long time, unsigned long mem_addr, int miss) {
+	unsigned long bin;
+	struct heatmap_cell *c;
+
+	if (h == NULL) return;
+	bin = mem_addr >> h->shift;
+	if (time / h->interval != h->cur) {
+		heatmap_flush(h);
+		h->cur = time / h->interval;
+	}
+	c = heatmap_slot(h->cells, h->size, bin);
+	if (c->accesses == 0) {
+		if (h->count + 1 > h->size / 2) {
+			if (heatmap_grow(h) != 0) return;
+			c = heatmap_slot(h->cells, h->size, bin);
+		}
+		c->bin = bin;
+		h->count++;
+	}
+	c->accesses++;
+	if (miss) c->misses++;
+}
+
+
+void heatmap_stats_reset(struct heatmap *h) {
+	if (h == NULL) return;
+	memset(h->cells, 0, h->size * sizeof(struct heatmap_cell));
+	h->count = 0;
+}
+
+
+void heatmap_close(struct heatmap *h) {
+	if (h == NULL) return;
+	heatmap_flush(h);
+	fclose(h->f);
+	free(h->cells);
+	free(h);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+/*
+ * Address x time heatmap of the memory accesses. Accesses and misses are binned by address
+ * (cache line, page, or any power-of-two granularity) and by instruction-count interval,
+ * and each interval is written out as it completes, as the non-zero cells of its row:
+ *
+ *     interval,address,accesses,misses
+ *
+ * where `interval` is the first instruction of the interval and `address` the first byte of
+ * the bin. `scripts/plot_heatmap.py` turns the file into an image.
+ */
+
+/* Define this as you'd like in your .c file. */
+struct heatmap;
+
+/*
+ * Create the heatmap file.
+ *
+ * @param path The CSV file to write.
+ * @param interval The number of instructions per row.
+ * @param granularity The number of bytes per address bin, a power of two.
+ * @return The heatmap, or NULL on error.
+ */
+struct heatmap *heatmap_open(const char *path, unsigned long interval, unsigned long granularity);
+
+/*
+ * Count one access. Times must not decrease from one access to the next.
+ *
+ * @param h The heatmap.
+ * @param time The number of instructions executed before the access.
+ * @param mem_addr The memory address accessed.
+ * @param miss Non-zero if the access missed in the cache.
+ */
+void heatmap_record(struct heatmap *h, unsigned long time, unsigned long mem_addr, int miss);
+
+/* Drop what the interval being collected counted so far */
+void heatmap_stats_reset(struct heatmap *h);
+
+/* Write out the last interval, and close the file */
+void heatmap_close(struct heatmap *h);
@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include "ilp.h"
+
+// Basic blocks listed in the report
+#define ILP_TOP_BLOCKS 10
+// Initial entries of the hash tables, a power of two
+#define ILP_TABLE_SIZE 1024
+
+// The last store to a word
+struct word_entry {
+	unsigned long word;                    // Word address + 1, 0 if empty
+	unsigned long done[ILP_WINDOWS_MAX];   // Cycle the store completed, in each window
+	unsigned long block, block_done;       // The block it was in, and when it completed within it
+};
+
+struct block_stat {
+	unsigned long pc;                      // The first instruction
+	unsigned long executions, instrs, path;
+};
+
+struct window {
+	unsigned long size;                    // 0 for unlimited
+	unsigned long reg_ready[32];           // Cycle each register's value is ready
+	unsigned long *retired;                // Retire cycles of the last `size` instructions
+	unsigned long last_retired, critical;
+	unsigned long start;                   // Earliest start since the last statistics reset
+};
+
+struct ilp {
+	struct ilp_config cfg;
+	unsigned long num_instrs, reset_instrs; // The second at the last statistics reset
+	struct window windows[ILP_WINDOWS_MAX];
+	struct word_entry *words;
+	unsigned long words_size, words_count;
+	// The block running: its number, first instruction, length and critical path so far,
+	// and when the registers it wrote are ready within it
+	unsigned long block, block_pc, block_instrs, block_path;
+	unsigned long reg_block[32], reg_block_ready[32];
+	struct block_stat *blocks;
+	unsigned long blocks_size, blocks_count;
+};
+
+
+struct ilp *ilp_alloc(struct ilp_config *cfg) {
+	struct ilp *il;
+
+	if (cfg->num_windows == 0 || cfg->num_windows > ILP_WINDOWS_MAX) {
+		fprintf(stderr, "Error: The limit study needs 1 to %d windows.\n", ILP_WINDOWS_MAX);
+		return NULL;
+	}
+	il = (struct ilp *)calloc(1, sizeof(struct ilp));
+	if (il == NULL) {
+		perror("Failed to allocate ILP limit study");
+		return NULL;
+	}
+	il->cfg = *cfg;
+	il->block = 1;
+	il->words_size = il->blocks_size = ILP_TABLE_SIZE;
+	il->words = (struct word_entry *)calloc(il->words_size, sizeof(struct word_entry));
+	il->blocks = (struct block_stat *)calloc(il->blocks_size, sizeof(struct block_stat));
+	if (il->words == NULL || il->blocks == NULL) {
+		perror("Failed to allocate ILP limit study");
+		ilp_free(il);
+		return NULL;
+	}
+	for (unsigned long w = 0; w < cfg->num_windows; w++) {
+		il->windows[w].size = cfg->windows[w];
+		if (cfg->windows[w] == 0) continue;
+		il->windows[w].retired = (unsigned long *)calloc(cfg->windows[w], sizeof(unsigned long));
+		if (il->windows[w].retired == NULL) {
+			perror("Failed to allocate ILP window");
+			ilp_free(il);
+			return NULL;
+		}
+	}
+
+	return il;
+}
+
+
+void ilp_free(struct ilp *il) {
+	if (il == NULL) return;
+	for (unsigned long w = 0; w < ILP_WINDOWS_MAX; w++) {
+		free(il->windows[w].retired);
+	}
+	free(il->words);
+	free(il->blocks);
+	free(il);
+}
+
+
+static struct word_entry *word_slot(struct word_entry *words, unsigned long size, unsigned long word) {
+	unsigned long i = (word * 0x9e3779b97f4a7c15UL) & (size - 1);
+
+	while (words[i].word != 0 && words[i].word != word + 1) {
+		i = (i + 1) & (size - 1);
+	}
+	return &words[i];
+}
+
+
+// The last store to a word, NULL if there is none and `create` is 0, or no memory for it
+static struct word_entry *word_lookup(struct ilp *il, unsigned long word, int create) {
+	struct word_entry *e = word_slot(il->words, il->words_size, word);
+
+	if (e->word != 0 || !create) return e->word != 0 ? e : NULL;
+	// Double the table when it is half full
+	if (il->words_count + 1 > il->words_size / 2) {
+		unsigned long size = il->words_size * 2;
+		struct word_entry *words = (struct word_entry *)calloc(size, sizeof(struct word_entry));
+
+		if (words == NULL) {
+			perror("Failed to grow ILP store table");
+			return NULL;
+		}
+		for (unsigned long j = 0; j < il->words_size; j++) {
+			if (il->words[j].word != 0) *word_slot(words, size, il->words[j].word - 1) = il->words[j];
+		}
+		free(il->words);
+		il->words = words;
+		il->words_size = size;
+		e = word_slot(il->words, il->words_size, word);
+	}
+	e->word = word + 1;
+	il->words_count++;
+
+	return e;
+}
+
+
+static struct block_stat *block_slot(struct block_stat *blocks, unsigned long size, unsigned long pc) {
+	unsigned long i = ((pc >> 2) * 0x9e3779b97f4a7c15UL) & (size - 1);
+
+	while (blocks[i].executions != 0 && blocks[i].pc != pc) {
+		i = (i + 1) & (size - 1);
+	}
+	return &blocks[i];
+}
+
+
+// Add the running block to the statistics of its first instruction, and start the next one
+static void block_end(struct ilp *il) {
+	struct block_stat *s;
+
+	if (il->block_instrs == 0) return;
+	s = block_slot(il->blocks, il->blocks_size, il->block_pc);
+	if (s->executions == 0 && il->blocks_count + 1 > il->blocks_size / 2) {
+		unsigned long size = il->blocks_size * 2;
+		struct block_stat *blocks = (struct block_stat *)calloc(size, sizeof(struct block_stat));
+
+		if (blocks == NULL) {
+			perror("Failed to grow ILP block statistics");
+			return;
+		}
+		for (unsigned long j = 0; j < il->blocks_size; j++) {
+			if (il->blocks[j].executions != 0) *block_slot(blocks, size, il->blocks[j].pc) = il->blocks[j];
+		}
+		free(il->blocks);
+		il->blocks = blocks;
+		il->blocks_size = size;
+		s = block_slot(il->blocks, il->blocks_size, il->block_pc);
+	}
+	if (s->executions == 0) il->blocks_count++;
+	s->pc = il->block_pc;
+	s->executions++;
+	s->instrs += il->block_instrs;
+	s->path += il->block_path;
+	il->block++;
+	il->block_instrs = il->block_path = 0;
+}
+
+
+void ilp_retire(struct ilp *il, struct instruction *i, int mem_hit, unsigned long mem_addr) {
+	enum instr_class class = instr_class(i->inst_no);
+	unsigned int rd, rs[2];
+	unsigned long lat, ready, done;
+	struct word_entry *st = NULL;
+
+	if (il == NULL) return;
+	instr_regs(i, &rd, &rs[0], &rs[1]);
+	switch (class) {
+	case CLASS_LOAD:
+		lat = mem_hit == 0 ? il->cfg.miss_latency : il->cfg.hit_latency;
+		st = word_lookup(il, mem_addr >> 3, 0);
+		break;
+	case CLASS_STORE:
+		lat = il->cfg.alu_latency;
+		st = word_lookup(il, mem_addr >> 3, 1);
+		break;
+	case CLASS_BRANCH:
+	case CLASS_JUMP:
+		lat = il->cfg.branch_latency;
+		break;
+	default:
+		lat = il->cfg.alu_latency;
+		break;
+	}
+
+	// Each window: start once the inputs are ready and the instruction fits in the window
+	for (unsigned long w = 0; w < il->cfg.num_windows; w++) {
+		struct window *win = &il->windows[w];
+
+		ready = 0;
+		for (int r = 0; r < 2; r++) {
+			if (rs[r] != 0 && win->reg_ready[rs[r]] > ready) ready = win->reg_ready[rs[r]];
+		}
+		if (class == CLASS_LOAD && st != NULL && st->done[w] > ready) ready = st->done[w];
+		if (win->size != 0 && il->num_instrs >= win->size && win->retired[il->num_instrs % win->size] > ready) {
+			ready = win->retired[il->num_instrs % win->size];
+		}
+		done = ready + lat;
+		if (ready < win->start) win->start = ready;
+		if (rd != 0) win->reg_ready[rd] = done;
+		if (class == CLASS_STORE && st != NULL) st->done[w] = done;
+		if (done > win->last_retired) win->last_retired = done;
+		if (win->size != 0) win->retired[il->num_instrs % win->size] = win->last_retired;
+		if (done > win->critical) win->critical = done;
+	}
+
+	// The block alone: inputs from earlier blocks are ready when it starts
+	if (il->block_instrs == 0) il->block_pc = i->inst_addr;
+	ready = 0;
+	for (int r = 0; r < 2; r++) {
+		if (rs[r] != 0 && il->reg_block[rs[r]] == il->block && il->reg_block_ready[rs[r]] > ready) ready = il->reg_block_ready[rs[r]];
+	}
+	if (class == CLASS_LOAD && st != NULL && st->block == il->block && st->block_done > ready) ready = st->block_done;
+	done = ready + lat;
+	if (rd != 0) {
+		il->reg_block[rd] = il->block;
+		il->reg_block_ready[rd] = done;
+	}
+	if (class == CLASS_STORE && st != NULL) {
+		st->block = il->block;
+		st->block_done = done;
+	}
+	if (done > il->block_path) il->block_path = done;
+	il->block_instrs++;
+	il->num_instrs++;
+	if (class == CLASS_BRANCH || class == CLASS_JUMP) block_end(il);
+}
+
+
+void ilp_stats_reset(struct ilp *il) {
+	if (il == NULL) return;
+	block_end(il);
+	memset(il->blocks, 0, il->blocks_size * sizeof(struct block_stat));
+	il->blocks_count = 0;
+	il->reset_instrs = il->num_instrs;
+	for (unsigned long w = 0; w < il->cfg.num_windows; w++) {
+		il->windows[w].critical = 0;
+		il->windows[w].start = ULONG_MAX;
+	}
+}
+
+
+// Most instructions first, then the lowest pc
+static int block_stat_cmp(const void *a, const void *b) {
+	const struct block_stat *x = *(const struct block_stat **)a, *y = *(const struct block_stat **)b;
+
+	if (x->instrs != y->instrs) return x->instrs > y->instrs ? -1 : 1;
+	return x->pc < y->pc ? -1 : (x->pc > y->pc);
+}
+
+
+void ilp_print(struct ilp *il) {
+	struct block_stat **blocks;
+	unsigned long n = 0;
+	unsigned long instrs, critical;
+	char window[32];
+
+	if (il == NULL) return;
+	block_end(il);
+	instrs = il->num_instrs - il->reset_instrs;
+	printf("ILP Limit: Instructions: %lu, Latencies: ALU %lu, Branch %lu, Load %lu (hit) / %lu (miss)\n",
+		instrs, il->cfg.alu_latency, il->cfg.branch_latency, il->cfg.hit_latency, il->cfg.miss_latency);
+	printf("%12s %16s %10s\n", "Window", "Critical Path", "ILP");
+	for (unsigned long w = 0; w < il->cfg.num_windows; w++) {
+		struct window *win = &il->windows[w];
+
+		if (win->size == 0) snprintf(window, sizeof(window), "unlimited");
+		else                snprintf(window, sizeof(window), "%lu", win->size);
+		critical = win->critical > win->start ? win->critical - win->start : 0;
+		printf("%12s %16lu %10.3f\n", window, critical,
+			critical == 0 ? 0.0 : (double)instrs / (double)critical);
+	}
+
+	// The blocks executing the most instructions, and the ILP within each
+	blocks = (struct block_stat **)malloc(il->blocks_count * sizeof(struct block_stat *) + 1);
+	if (blocks == NULL) {
+		perror("Failed to sort ILP block statistics");
+		return;
+	}
+	for (unsigned long j = 0; j < il->blocks_size; j++) {
+		if (il->blocks[j].executions != 0) blocks[n++] = &il->blocks[j];
+	}
+	qsort(blocks, n, sizeof(struct block_stat *), block_stat_cmp);
+	if (n > ILP_TOP_BLOCKS) n = ILP_TOP_BLOCKS;
+	if (n > 0) {
+		printf("Hottest Basic Blocks:\n");
+		printf("%18s %12s %14s %10s %14s %10s\n", "Block", "Executions", "Instructions", "Length", "Critical Path", "ILP");
+	}
+	for (unsigned long j = 0; j < n; j++) {
+		struct block_stat *s = blocks[j];
+
+		printf("%#18lx %12lu %14lu %10.2f %14.2f %10.3f\n", s->pc, s->executions, s->instrs,
+			(double)s->instrs / (double)s->executions, (double)s->path / (double)s->executions,
+			s->path == 0 ? 0.0 : (double)s->instrs / (double)s->path);
+	}
+	free(blocks);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <instructions.h>
+
+/* Most instruction windows measured side by side in one run */
+#define ILP_WINDOWS_MAX 8
+
+/*
+ * A dataflow limit study: the instruction-level parallelism of the executed instructions on
+ * an ideal machine, an upper bound for what any core could extract. The machine has perfect
+ * branch prediction, perfect register renaming and infinite width, so each instruction
+ * executes as soon as its inputs are available: the registers it reads, and for a load, the
+ * value of the last store to the same word. The only limit is the instruction window: an
+ * instruction can't start before the one `window` instructions older retired (in order, once
+ * it and all the older ones completed).
+ *
+ * The critical path is the cycle the last instruction completes, and the ILP the instructions
+ * per cycle of the critical path. Each basic block (a dynamic run of instructions ending with
+ * a branch or jump) is also measured alone, with an unlimited window and its inputs from
+ * earlier blocks ready when it starts, which shows how much parallelism is local to it.
+ */
+
+struct ilp_config {
+	unsigned long num_windows;               // Windows measured side by side
+	unsigned long windows[ILP_WINDOWS_MAX];  // Instructions in each window, 0 for an unlimited one
+	unsigned long alu_latency;               // Cycles of an ALU operation
+	unsigned long branch_latency;            // Cycles of a branch or jump
+	unsigned long hit_latency;               // Cycles of a load that hits in the cache
+	unsigned long miss_latency;              // Cycles of a load that misses
+};
+
+/* Define this as you'd like in your .c file. */
+struct ilp;
+
+struct ilp *ilp_alloc(struct ilp_config *cfg);
+void ilp_free(struct ilp *il);
+
+/*
+ * Account for one executed instruction.
+ *
+ * @param il The limit study.
+ * @param i The instruction.
+ * @param mem_hit For loads and stores, 1 if the access hit in the cache and 0 if it missed.
+ * @param mem_addr For loads and stores, the address accessed.
+ */
+void ilp_retire(struct ilp *il, struct instruction *i, int mem_hit, unsigned long mem_addr);
+
+/*
+ * Measure the instructions from now on: the critical path of each window runs from the
+ * first cycle one of them can start, and the basic block statistics are zeroed.
+ */
+void ilp_stats_reset(struct ilp *il);
+
+/*
+ * Print the critical path and the ILP for each window, and the basic blocks executing the
+ * most instructions with the ILP within each.
+ */
+void ilp_print(struct ilp *il);
@@ -67,6 +67,20 @@ enum instruction_num {
 	INSTRINVALID,		/* Used as the return value for invalid instructions */
 };
 
+/*
+ * Coarse classes of instructions, for instruction-mix statistics and
+ * timing models. `auipc` and `lui` are ALU operations.
+ */
+enum instr_class {
+	CLASS_ALU,
+	CLASS_LOAD,
+	CLASS_STORE,
+	CLASS_BRANCH,	/* Conditional branches */
+	CLASS_JUMP,	/* jal and jalr */
+	CLASS_SYSTEM,	/* ecall */
+	CLASS_COUNT,
+};
+
 enum instr_fmt {
 	FMT_RRR,
 	FMT_RRI,
@@ -180,6 +194,9 @@ void free_lines(char **lines);
 enum instr_fmt instr_format(enum instruction_num n);
 enum instruction_num instr_num(char *instr);
 char *instr_name(enum instruction_num n);
+enum instr_class instr_class(enum instruction_num n);
+char *instr_class_name(enum instr_class c);
+void instr_regs(struct instruction *i, unsigned int *rd, unsigned int *rs1, unsigned int *rs2);
 /* Print out a single instruction */
 void instruction_print(struct instruction *i);
 /* Print out all of the instructions */
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "interval_stats.h"
+
+struct interval_stats {
+	FILE *f;
+	int json;
+	unsigned long interval;
+	unsigned long num_instrs;                 // Since the start of the run
+	unsigned long mix[CLASS_COUNT];           // Instructions of each class in this interval
+	struct cache_stats last;                  // Cache statistics at the start of this interval
+};
+
+
+struct interval_stats *interval_stats_open(const char *path, unsigned long interval, int json) {
+	struct interval_stats *s;
+
+	if (interval == 0) {
+		fprintf(stderr, "Error: The statistics interval must be at least one instruction.\n");
+		return NULL;
+	}
+	s = (struct interval_stats *)calloc(1, sizeof(struct interval_stats));
+	if (s == NULL) {
+		perror("Failed to allocate interval statistics");
+		return NULL;
+	}
+	s->f = fopen(path, "w");
+	if (s->f == NULL) {
+		perror("Failed to create statistics file");
+		free(s);
+		return NULL;
+	}
+	s->interval = interval;
+	s->json = json;
+	if (!json) {
+		fprintf(s->f, "instructions,interval_instructions,loads,stores,cache_accesses,cache_misses,miss_rate");
+		for (int c = 0; c < CLASS_COUNT; c++) {
+			fprintf(s->f, ",%s", instr_class_name(c));
+		}
+		fprintf(s->f, "\n");
+	}
+
+	return s;
+}
+
+
+// Write the record of the interval that just ended, and start the next one
+static void interval_stats_emit(struct interval_stats *s, struct cache *cache) {
+	struct cache_stats cs = cache_statistics(cache);
+	unsigned long n = 0, accesses = cs.num_cache_accesses - s->last.num_cache_accesses;
+	unsigned long misses = cs.num_cache_misses - s->last.num_cache_misses;
+	double miss_rate = accesses == 0 ? 0.0 : (double)misses / (double)accesses;
+
+	for (int c = 0; c < CLASS_COUNT; c++) {
+		n += s->mix[c];
+	}
+	if (s->json) {
+		fprintf(s->f, "{\"instructions\": %lu, \"interval_instructions\": %lu, \"loads\": %lu, \"stores\": %lu, "
+			"\"cache_accesses\": %lu, \"cache_misses\": %lu, \"miss_rate\": %.6f, \"mix\": {",
+			s->num_instrs, n, s->mix[CLASS_LOAD], s->mix[CLASS_STORE], accesses, misses, miss_rate);
+		for (int c = 0; c < CLASS_COUNT; c++) {
+			fprintf(s->f, "%s\"%s\": %lu", c ? ", " : "", instr_class_name(c), s->mix[c]);
+		}
+		fprintf(s->f, "}}\n");
+	} else {
+		fprintf(s->f, "%lu,%lu,%lu,%lu,%lu,%lu,%.6f", s->num_instrs, n, s->mix[CLASS_LOAD], s->mix[CLASS_STORE],
+			accesses, misses, miss_rate);
+		for (int c = 0; c < CLASS_COUNT; c++) {
+			fprintf(s->f, ",%lu", s->mix[c]);
+		}
+		fprintf(s->f, "\n");
+	}
+	// Let whoever follows the file see the record right away
+	fflush(s->f);
+
+	s->last = cs;
+	for (int c = 0; c < CLASS_COUNT; c++) {
+		s->mix[c] = 0;
+	}
+}
+
+
+void interval_stats_record(struct interval_stats *s, enum instr_class c, struct cache *cache) {
+	if (s == NULL) return;
+	s->mix[c]++;
+	s->num_instrs++;
+	if (s->num_instrs % s->interval == 0) interval_stats_emit(s, cache);
+}
+
+
+void interval_stats_reset(struct interval_stats *s, struct cache *cache) {
+	if (s == NULL) return;
+	s->last = cache_statistics(cache);
+	for (int c = 0; c < CLASS_COUNT; c++) {
+		s->mix[c] = 0;
+	}
+}
+
+
+void interval_stats_close(struct interval_stats *s, struct cache *cache) {
+	if (s == NULL) return;
+	if (s->num_instrs % s->interval != 0) interval_stats_emit(s, cache);
+	fclose(s->f);
+	free(s);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <instructions.h>
+#include <cache.h>
+
+/*
+ * Time-series statistics: every `interval` instructions, append one record with the
+ * instructions executed so far and, for that interval, the loads and stores, the cache
+ * accesses and misses, and the instruction mix. Records are CSV lines (with a header) or
+ * JSON objects, one per line, and are flushed as they are written so a long run can be
+ * watched while it executes.
+ */
+
+/* Define this as you'd like in your .c file. */
+struct interval_stats;
+
+/*
+ * Create the statistics file.
+ *
+ * @param path The file to write.
+ * @param interval The number of instructions per record.
+ * @param json Non-zero for JSON lines, zero for CSV.
+ * @return The statistics, or NULL on error.
+ */
+struct interval_stats *interval_stats_open(const char *path, unsigned long interval, int json);
+
+/*
+ * Count one executed instruction, and write a record if it ends an interval.
+ *
+ * @param s The statistics.
+ * @param c The class of the instruction.
+ * @param cache The cache whose accesses and misses are reported.
+ */
+void interval_stats_record(struct interval_stats *s, enum instr_class c, struct cache *cache);
+
+/*
+ * Restart the interval being collected, after the cache's statistics were reset: its
+ * record only covers the instructions, accesses and misses from now on. Records stay
+ * every `interval` instructions of the run.
+ *
+ * @param s The statistics.
+ * @param cache The cache whose accesses and misses are reported.
+ */
+void interval_stats_reset(struct interval_stats *s, struct cache *cache);
+
+/* Write the last, partial, interval if it has any instruction, and close the file */
+void interval_stats_close(struct interval_stats *s, struct cache *cache);
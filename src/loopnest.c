@@ -0,0 +1,644 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "loopnest.h"
+#include "cache.h"
+#include "pc_stats.h"
+
+// Deepest loop nest analyzed, most loops and most loads/stores
+#define LOOPNEST_DEPTH_MAX 8
+#define LOOPNEST_LOOPS_MAX 64
+#define LOOPNEST_REFS_MAX 256
+
+// A register's value: c0 + c[0]*i0 + c[1]*i1 + ..., the iteration numbers of the loops at each depth
+struct affine {
+	int known;
+	long c0;
+	long c[LOOPNEST_DEPTH_MAX];
+};
+
+struct loop {
+	unsigned long header, latch; // Indices of its first instruction and of its backward branch
+	long parent;                 // The loop around it, -1 for none
+	unsigned long depth;         // 0 for an outermost loop
+	long trips;                  // Iterations per execution, -1 if unknown
+	unsigned long ivs;           // Bit r set if register r is an induction variable
+	long steps[32];              // And its step
+	int fits;                    // One iteration's data fits in the cache
+};
+
+struct ref {
+	unsigned long index;                 // Of the load/store instruction
+	unsigned long depth;                 // Loops around it
+	long loops[LOOPNEST_DEPTH_MAX];      // The loop at each depth
+	struct affine addr;
+	unsigned long size;
+	long leader;                         // The reference whose lines it shares, -1 if none
+	long accesses, misses;               // -1 if unknown
+};
+
+// What a reference touches during one execution of a loop
+struct footprint {
+	unsigned long lines, span; // Distinct lines, and bytes from the lowest to the highest address
+	long misses;
+};
+
+struct loopnest {
+	struct instructions *instrs;
+	unsigned long instr_lower, num_lines, num_sets, num_ways;
+	struct loop loops[LOOPNEST_LOOPS_MAX];
+	unsigned long num_loops;
+	struct ref refs[LOOPNEST_REFS_MAX];
+	unsigned long num_refs;
+	int stopped;                         // The walk reached a call, an indirect jump or the exit
+	struct pc_stats *actual;             // Accesses recorded while executing, if any
+	int recorded;
+};
+
+
+static long ceil_div(long a, long b) {
+	return (a + b - 1) / b;
+}
+
+
+static unsigned long gcd(unsigned long a, unsigned long b) {
+	while (b != 0) {
+		unsigned long t = a % b;
+
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+
+static struct affine constant(long v) {
+	return (struct affine){ .known = 1, .c0 = v };
+}
+
+
+static int is_constant(const struct affine *a) {
+	if (!a->known) return 0;
+	for (int d = 0; d < LOOPNEST_DEPTH_MAX; d++) {
+		if (a->c[d] != 0) return 0;
+	}
+	return 1;
+}
+
+
+// a + sign * b
+static struct affine affine_add(const struct affine *a, const struct affine *b, long sign) {
+	struct affine r = { 0 };
+
+	if (!a->known || !b->known) return r;
+	r.known = 1;
+	r.c0 = a->c0 + sign * b->c0;
+	for (int d = 0; d < LOOPNEST_DEPTH_MAX; d++) {
+		r.c[d] = a->c[d] + sign * b->c[d];
+	}
+	return r;
+}
+
+
+static struct affine affine_scale(const struct affine *a, long k) {
+	struct affine r = *a;
+
+	r.c0 *= k;
+	for (int d = 0; d < LOOPNEST_DEPTH_MAX; d++) {
+		r.c[d] *= k;
+	}
+	return r;
+}
+
+
+// How many times an instruction runs per iteration of loop `l`, -1 if unknown
+static long runs_per_iteration(struct loopnest *ln, long l, unsigned long index) {
+	long runs = 1;
+
+	for (unsigned long o = 0; o < ln->num_loops; o++) {
+		struct loop *op = &ln->loops[o];
+
+		if ((long)o == l || op->depth <= ln->loops[l].depth || op->header > index || op->latch < index) continue;
+		if (op->trips < 0) return -1;
+		runs *= op->trips;
+	}
+	return runs;
+}
+
+
+// The backward conditional branches, properly nested
+static void find_loops(struct loopnest *ln) {
+	struct instructions *instrs = ln->instrs;
+
+	for (unsigned long b = 0; b < (unsigned long)instrs->num_instructions; b++) {
+		struct instruction *i = &instrs->instructions[b];
+		long target;
+		int nested = 1;
+
+		if (instr_class(i->inst_no) != CLASS_BRANCH || i->format.rri.imm >= 0) continue;
+		target = (long)b + i->format.rri.imm / 4;
+		if (target < 0 || ln->num_loops == LOOPNEST_LOOPS_MAX) continue;
+		// Loops are found by their latch, in order: an earlier one must be inside this one,
+		// or before it
+		for (unsigned long l = 0; l < ln->num_loops; l++) {
+			struct loop *lp = &ln->loops[l];
+
+			if (lp->header < (unsigned long)target && lp->latch >= (unsigned long)target) nested = 0;
+		}
+		if (!nested) continue;
+		ln->loops[ln->num_loops++] = (struct loop){ .header = target, .latch = b, .parent = -1, .trips = -1 };
+	}
+	// Number them outermost first, in program order
+	for (unsigned long l = 1; l < ln->num_loops; l++) {
+		for (unsigned long o = l; o > 0 && ln->loops[o - 1].header > ln->loops[o].header; o--) {
+			struct loop t = ln->loops[o];
+
+			ln->loops[o] = ln->loops[o - 1];
+			ln->loops[o - 1] = t;
+		}
+	}
+	// The parent of a loop is the smallest one around it
+	for (unsigned long l = 0; l < ln->num_loops; l++) {
+		struct loop *lp = &ln->loops[l];
+
+		for (unsigned long o = 0; o < ln->num_loops; o++) {
+			struct loop *op = &ln->loops[o];
+
+			if (o == l || op->header > lp->header || op->latch < lp->latch) continue;
+			if (lp->parent < 0 || op->latch - op->header < ln->loops[lp->parent].latch - ln->loops[lp->parent].header) lp->parent = o;
+		}
+	}
+	for (unsigned long l = 0; l < ln->num_loops; l++) {
+		for (long p = ln->loops[l].parent; p >= 0; p = ln->loops[p].parent) {
+			ln->loops[l].depth++;
+		}
+	}
+}
+
+
+static void record_ref(struct loopnest *ln, unsigned long index, long loop, struct affine *addr, unsigned long size) {
+	struct ref *r;
+
+	if (ln->num_refs == LOOPNEST_REFS_MAX) return;
+	r = &ln->refs[ln->num_refs++];
+	*r = (struct ref){ .index = index, .addr = *addr, .size = size, .leader = -1, .accesses = -1, .misses = -1 };
+	if (loop >= 0) r->depth = ln->loops[loop].depth + 1;
+	for (long l = loop; l >= 0; l = ln->loops[l].parent) {
+		r->loops[ln->loops[l].depth] = l;
+	}
+}
+
+
+// The value of an ALU operation on constants, 0 if it isn't one this handles
+static int alu_constant(enum instruction_num n, long a, long b, long *v) {
+	switch (n) {
+	case AND: case ANDI:   *v = a & b; break;
+	case OR: case ORI:     *v = a | b; break;
+	case XOR: case XORI:   *v = a ^ b; break;
+	case SRL: case SRLI:   *v = (long)((unsigned long)a >> (b & 0x3f)); break;
+	case SRA: case SRAI:   *v = a >> (b & 0x3f); break;
+	case SLT: case SLTI:   *v = a < b; break;
+	case SLTU: case SLTIU: *v = (unsigned long)a < (unsigned long)b; break;
+	default: return 0;
+	}
+	return 1;
+}
+
+
+// The effect of an instruction that isn't a loop's branch on the registers
+static void evaluate(struct loopnest *ln, unsigned long index, long loop, struct affine *regs) {
+	struct instruction *i = &ln->instrs->instructions[index];
+	unsigned long pc = ln->instr_lower + index * 4;
+	struct affine v = { 0 }, imm;
+	unsigned int rd, rs1, rs2;
+	long k;
+
+	instr_regs(i, &rd, &rs1, &rs2);
+	switch (i->inst_no) {
+	case ADDI: case ADDIW:
+		imm = constant(i->format.rri.imm);
+		v = affine_add(&regs[rs1], &imm, 1);
+		break;
+	case ADD: case ADDW:
+		v = affine_add(&regs[rs1], &regs[rs2], 1);
+		break;
+	case SUB: case SUBW:
+		v = affine_add(&regs[rs1], &regs[rs2], -1);
+		break;
+	case SLLI: case SLLIW:
+		if (regs[rs1].known) v = affine_scale(&regs[rs1], 1L << (i->format.rri.imm & 0x3f));
+		break;
+	case SLL: case SLLW:
+		if (regs[rs1].known && is_constant(&regs[rs2])) v = affine_scale(&regs[rs1], 1L << (regs[rs2].c0 & 0x3f));
+		break;
+	case LUI:
+		v = constant(i->format.ri.imm << 12);
+		break;
+	case AUIPC:
+		v = constant((long)pc + (i->format.ri.imm << 12));
+		break;
+	case SB: case SH: case SW: case SD:
+	case LB: case LH: case LW: case LBU: case LHU: case LWU: case LD: {
+		unsigned long size = i->inst_no == SB || i->inst_no == LB || i->inst_no == LBU ? 1 :
+				     i->inst_no == SH || i->inst_no == LH || i->inst_no == LHU ? 2 :
+				     i->inst_no == SW || i->inst_no == LW || i->inst_no == LWU ? 4 : 8;
+
+		imm = constant(i->format.ror.offset);
+		v = affine_add(&regs[i->format.ror.r1], &imm, 1);
+		record_ref(ln, index, loop, &v, size);
+		v = (struct affine){ 0 }; // A load's value is unknown
+		break;
+	}
+	case JAL: case JALR:
+		ln->stopped = 1;
+		return;
+	case ECALL:
+		if (is_constant(&regs[17]) && regs[17].c0 == 2) ln->stopped = 1;
+		return;
+	default:
+		// Forward branches fall through, other operations need constants
+		if (instr_class(i->inst_no) == CLASS_BRANCH) return;
+		if (i->fmt_type == FMT_RRI && is_constant(&regs[rs1]) && alu_constant(i->inst_no, regs[rs1].c0, i->format.rri.imm, &k)) v = constant(k);
+		if (i->fmt_type == FMT_RRR && is_constant(&regs[rs1]) && is_constant(&regs[rs2]) && alu_constant(i->inst_no, regs[rs1].c0, regs[rs2].c0, &k)) v = constant(k);
+		break;
+	}
+	// The 32-bit operations sign-extend their result
+	if (v.known && is_constant(&v) && (i->inst_no == ADDIW || i->inst_no == ADDW || i->inst_no == SUBW ||
+					  i->inst_no == SLLIW || i->inst_no == SLLW)) {
+		v.c0 = (int)v.c0;
+	}
+	if (rd != 0) regs[rd] = v;
+}
+
+
+/*
+ * The iterations of a loop whose branch compares `x` and `y`, -1 if unknown: one side must
+ * step with the loop at `depth`, and the other be constant.
+ */
+static long trip_count(enum instruction_num n, struct affine *x, struct affine *y, unsigned long depth) {
+	struct affine *v, *b, base;
+	long a0, s, bound, k;
+	int iv_first;
+
+	if (!x->known || !y->known) return -1;
+	iv_first = x->c[depth] != 0;
+	v = iv_first ? x : y;
+	b = iv_first ? y : x;
+	base = *v;
+	base.c[depth] = 0;
+	if (v->c[depth] == 0 || !is_constant(&base) || !is_constant(b)) return -1;
+	a0 = v->c0;
+	s = v->c[depth];
+	bound = b->c0;
+
+	// The first iteration (from 0) at which the loop stops
+	switch (n) {
+	case BLT: case BLTU:
+		if (iv_first) {           // Continue while v < bound
+			if (a0 >= bound) k = 0;
+			else if (s > 0) k = ceil_div(bound - a0, s);
+			else return -1;
+		} else {                  // Continue while v > bound
+			if (a0 <= bound) k = 0;
+			else if (s < 0) k = ceil_div(a0 - bound, -s);
+			else return -1;
+		}
+		break;
+	case BGE: case BGEU:
+		if (iv_first) {           // Continue while v >= bound
+			if (a0 < bound) k = 0;
+			else if (s < 0) k = (a0 - bound) / -s + 1;
+			else return -1;
+		} else {                  // Continue while v <= bound
+			if (a0 > bound) k = 0;
+			else if (s > 0) k = (bound - a0) / s + 1;
+			else return -1;
+		}
+		break;
+	case BNE:
+		if ((bound - a0) % s != 0 || (bound - a0) / s < 0) return -1;
+		k = (bound - a0) / s;
+		break;
+	default:
+		return -1;
+	}
+	return k + 1;
+}
+
+
+static void walk(struct loopnest *ln, unsigned long from, unsigned long to, long loop, struct affine *regs);
+
+
+/*
+ * Walk a loop's body once, with its induction variables stepping with its iterations: the
+ * registers it only changes with `addi r,r,c`, by the sum of those per iteration. Steps
+ * taken in inner loops need their trip counts, from a first walk.
+ */
+static void walk_loop(struct loopnest *ln, long l, struct affine *regs) {
+	struct loop *lp = &ln->loops[l];
+	struct instruction *branch = &ln->instrs->instructions[lp->latch];
+	struct affine body[32];
+	unsigned long written = 0, inner_steps = 0, num_refs = ln->num_refs;
+
+	// The registers the loop writes, and how
+	lp->ivs = 0;
+	for (unsigned long index = lp->header; index <= lp->latch; index++) {
+		struct instruction *i = &ln->instrs->instructions[index];
+		unsigned int rd, rs1, rs2;
+
+		instr_regs(i, &rd, &rs1, &rs2);
+		if (rd == 0) continue;
+		if (!(written & (1UL << rd)) && i->inst_no == ADDI && i->format.rri.rs1 == rd) lp->ivs |= 1UL << rd;
+		if (i->inst_no != ADDI || i->format.rri.rs1 != rd) lp->ivs &= ~(1UL << rd);
+		written |= 1UL << rd;
+		if (runs_per_iteration(ln, l, index) != 1) inner_steps |= 1UL << rd;
+	}
+	for (int pass = (lp->ivs & inner_steps) ? 0 : 1; pass < 2; pass++) {
+		unsigned long stepping = pass == 1 ? lp->ivs : lp->ivs & ~inner_steps;
+
+		memset(lp->steps, 0, sizeof(lp->steps));
+		for (unsigned long index = lp->header; index <= lp->latch; index++) {
+			struct instruction *i = &ln->instrs->instructions[index];
+			long runs;
+
+			if (i->inst_no != ADDI || !(stepping & (1UL << i->format.rri.rd))) continue;
+			runs = runs_per_iteration(ln, l, index);
+			if (runs < 0) stepping &= ~(1UL << i->format.rri.rd);
+			lp->steps[i->format.rri.rd] += runs * i->format.rri.imm;
+		}
+		memcpy(body, regs, sizeof(body));
+		for (unsigned int r = 1; r < 32; r++) {
+			if (!(written & (1UL << r))) continue;
+			if ((stepping & (1UL << r)) && regs[r].known) body[r].c[lp->depth] = lp->steps[r];
+			else body[r] = (struct affine){ 0 };
+		}
+		if (pass == 1) lp->ivs = stepping;
+		// The first walk only finds the inner loops' trip counts
+		ln->num_refs = num_refs;
+		walk(ln, lp->header, lp->latch, l, body);
+	}
+	if (!ln->stopped) lp->trips = trip_count(branch->inst_no, &body[branch->format.rri.rd], &body[branch->format.rri.rs1], lp->depth);
+
+	// After the loop, the registers hold their values from its last iteration
+	for (unsigned int r = 1; r < 32; r++) {
+		if (!(written & (1UL << r))) continue;
+		if (lp->trips < 0 || !body[r].known) {
+			regs[r] = (struct affine){ 0 };
+			continue;
+		}
+		regs[r] = body[r];
+		regs[r].c0 += regs[r].c[lp->depth] * (lp->trips - 1);
+		regs[r].c[lp->depth] = 0;
+	}
+}
+
+
+// Walk the instructions [from, to) inside `loop`, entering the loops directly inside it
+static void walk(struct loopnest *ln, unsigned long from, unsigned long to, long loop, struct affine *regs) {
+	for (unsigned long index = from; index < to && !ln->stopped; index++) {
+		long inner = -1;
+
+		for (unsigned long l = 0; l < ln->num_loops; l++) {
+			if (ln->loops[l].header == index && ln->loops[l].parent == loop) inner = l;
+		}
+		if (inner >= 0 && ln->loops[inner].depth < LOOPNEST_DEPTH_MAX) {
+			walk_loop(ln, inner, regs);
+			index = ln->loops[inner].latch;
+			continue;
+		}
+		evaluate(ln, index, loop, regs);
+	}
+}
+
+
+static unsigned long lines_in(unsigned long span) {
+	return (span + CACHE_BLOCK_SIZE - 1) / CACHE_BLOCK_SIZE;
+}
+
+
+// What a reference touches during one execution of its loop at `depth`, or one access
+static struct footprint footprint(struct loopnest *ln, struct ref *r, unsigned long depth) {
+	struct footprint inner, f;
+	struct loop *lp;
+	unsigned long stride;
+
+	if (depth >= r->depth) return (struct footprint){ .lines = 1, .span = r->size, .misses = 1 };
+	inner = footprint(ln, r, depth + 1);
+	lp = &ln->loops[r->loops[depth]];
+	stride = labs(r->addr.c[depth]);
+	if (lp->trips < 0 || inner.misses < 0) return (struct footprint){ .misses = -1 };
+
+	f.span = (lp->trips - 1) * stride + inner.span;
+	f.lines = lines_in(f.span);
+	if (f.lines > lp->trips * inner.lines) f.lines = lp->trips * inner.lines;
+	if (stride == 0) f.lines = inner.lines;
+	// Lines reused from one iteration to the next survive if one iteration's data fits
+	if (lp->fits) f.misses = inner.misses + (f.lines - inner.lines);
+	else          f.misses = lp->trips * inner.misses;
+
+	return f;
+}
+
+
+// The most lines of a reference's footprint in one set, over one execution of its loop at `depth`
+static unsigned long set_load(struct loopnest *ln, struct ref *r, unsigned long depth, unsigned long lines) {
+	unsigned long stride = 0, sets;
+
+	for (unsigned long d = depth; d < r->depth; d++) {
+		if (r->addr.c[d] != 0) stride = labs(r->addr.c[d]) / CACHE_BLOCK_SIZE;
+	}
+	// Consecutive lines use consecutive sets, a stride of lines one set in gcd(stride, sets)
+	sets = stride == 0 ? ln->num_sets : ln->num_sets / gcd(stride % ln->num_sets ? stride % ln->num_sets : ln->num_sets, ln->num_sets);
+	if (sets > lines) sets = lines;
+	return sets == 0 ? 0 : (lines + sets - 1) / sets;
+}
+
+
+// Whether the data one iteration of a loop touches fits in the cache, by capacity and per set
+static int loop_fits(struct loopnest *ln, long l) {
+	unsigned long depth = ln->loops[l].depth, lines = 0, load = 0;
+
+	for (unsigned long j = 0; j < ln->num_refs; j++) {
+		struct ref *r = &ln->refs[j];
+		struct footprint f;
+
+		if (r->depth <= depth || r->loops[depth] != l || r->leader >= 0 || !r->addr.known) continue;
+		f = footprint(ln, r, depth + 1);
+		if (f.misses < 0) return 0;
+		lines += f.lines;
+		load += set_load(ln, r, depth + 1, f.lines);
+	}
+	return lines <= ln->num_lines && load <= ln->num_ways;
+}
+
+
+// References in the same loops, at the same strides, that always touch the same line
+static int same_lines(struct ref *a, struct ref *b) {
+	int line_strides = 1;
+
+	if (!a->addr.known || !b->addr.known || a->depth != b->depth) return 0;
+	for (unsigned long d = 0; d < a->depth; d++) {
+		if (a->loops[d] != b->loops[d] || a->addr.c[d] != b->addr.c[d]) return 0;
+		if (a->addr.c[d] % CACHE_BLOCK_SIZE != 0) line_strides = 0;
+	}
+	if (line_strides) return a->addr.c0 / CACHE_BLOCK_SIZE == b->addr.c0 / CACHE_BLOCK_SIZE;
+	return labs(a->addr.c0 - b->addr.c0) < CACHE_BLOCK_SIZE;
+}
+
+
+static void predict(struct loopnest *ln) {
+	// Group the references sharing lines behind the first of them
+	for (unsigned long j = 0; j < ln->num_refs; j++) {
+		for (unsigned long e = 0; e < j && ln->refs[j].leader < 0; e++) {
+			if (ln->refs[e].leader < 0 && same_lines(&ln->refs[e], &ln->refs[j])) ln->refs[j].leader = e;
+		}
+	}
+	// Whether each loop's iterations fit, the innermost loops first
+	for (long depth = LOOPNEST_DEPTH_MAX - 1; depth >= 0; depth--) {
+		for (unsigned long l = 0; l < ln->num_loops; l++) {
+			if (ln->loops[l].depth == (unsigned long)depth) ln->loops[l].fits = loop_fits(ln, l);
+		}
+	}
+	for (unsigned long j = 0; j < ln->num_refs; j++) {
+		struct ref *r = &ln->refs[j];
+
+		r->accesses = 1;
+		for (unsigned long d = 0; d < r->depth; d++) {
+			long trips = ln->loops[r->loops[d]].trips;
+
+			r->accesses = trips < 0 || r->accesses < 0 ? -1 : r->accesses * trips;
+		}
+		if (!r->addr.known || r->accesses < 0) r->misses = -1;
+		else if (r->leader >= 0)               r->misses = 0;
+		else                                   r->misses = footprint(ln, r, 0).misses;
+	}
+}
+
+
+struct loopnest *loopnest_analyze(struct instructions *instrs, unsigned long instr_lower, unsigned long entry,
+				  unsigned long num_lines, unsigned long num_sets) {
+	struct loopnest *ln;
+	struct affine regs[32] = { 0 };
+
+	if (num_sets == 0 || num_lines < num_sets || num_lines % num_sets != 0) {
+		fprintf(stderr, "Error: The static cache analysis needs a valid cache geometry.\n");
+		return NULL;
+	}
+	ln = (struct loopnest *)calloc(1, sizeof(struct loopnest));
+	if (ln == NULL) {
+		perror("Failed to allocate static cache analysis");
+		return NULL;
+	}
+	*ln = (struct loopnest){ .instrs = instrs, .instr_lower = instr_lower, .num_lines = num_lines,
+				 .num_sets = num_sets, .num_ways = num_lines / num_sets };
+	if (!(ln->actual = pc_stats_alloc())) {
+		free(ln);
+		return NULL;
+	}
+
+	find_loops(ln);
+	regs[0] = constant(0);
+	if (entry >= instr_lower) walk(ln, (entry - instr_lower) / 4, (unsigned long)instrs->num_instructions, -1, regs);
+	predict(ln);
+
+	return ln;
+}
+
+
+void loopnest_free(struct loopnest *ln) {
+	if (ln == NULL) return;
+	pc_stats_free(ln->actual);
+	free(ln);
+}
+
+
+void loopnest_record(struct loopnest *ln, unsigned long pc, int miss) {
+	pc_stats_record(ln->actual, pc, miss);
+	ln->recorded = 1;
+}
+
+
+// Print an address as c0 + c1*i<loop> + ...
+static void affine_print(struct ref *r) {
+	char buf[128];
+	int len;
+
+	if (!r->addr.known) {
+		printf(" %-32s", "?");
+		return;
+	}
+	len = snprintf(buf, sizeof(buf), "%#lx", r->addr.c0);
+	for (unsigned long d = 0; d < r->depth && len < (int)sizeof(buf); d++) {
+		if (r->addr.c[d] == 0) continue;
+		len += snprintf(buf + len, sizeof(buf) - len, " %c ", r->addr.c[d] < 0 ? '-' : '+');
+		if (labs(r->addr.c[d]) != 1 && len < (int)sizeof(buf)) len += snprintf(buf + len, sizeof(buf) - len, "%ld*", labs(r->addr.c[d]));
+		if (len < (int)sizeof(buf)) len += snprintf(buf + len, sizeof(buf) - len, "i%ld", r->loops[d]);
+	}
+	printf(" %-32s", buf);
+}
+
+
+void loopnest_stats_reset(struct loopnest *ln) {
+	if (ln == NULL) return;
+	pc_stats_reset(ln->actual);
+}
+
+
+void loopnest_print(struct loopnest *ln) {
+	long accesses = 0, misses = 0;
+	int complete = 1;
+
+	if (ln == NULL) return;
+	printf("Static Cache Analysis: %lu lines, %lu sets (%lu-way), %lu loops, %lu references\n",
+		ln->num_lines, ln->num_sets, ln->num_ways, ln->num_loops, ln->num_refs);
+	if (ln->num_loops > 0) {
+		printf("Loops:\n");
+		printf("%8s %10s %10s %6s %10s  %s\n", "Loop", "Header", "Latch", "Depth", "Trips", "Induction Variables");
+	}
+	for (unsigned long l = 0; l < ln->num_loops; l++) {
+		struct loop *lp = &ln->loops[l];
+		int first = 1;
+
+		printf("%8lu %#10lx %#10lx %6lu ", l, ln->instr_lower + lp->header * 4, ln->instr_lower + lp->latch * 4, lp->depth);
+		if (lp->trips < 0) printf("%10s  ", "?");
+		else               printf("%10ld  ", lp->trips);
+		for (unsigned int r = 1; r < 32; r++) {
+			if (!(lp->ivs & (1UL << r))) continue;
+			printf("%sx%u %c= %ld", first ? "" : ", ", r, lp->steps[r] < 0 ? '-' : '+', labs(lp->steps[r]));
+			first = 0;
+		}
+		printf("%s\n", first ? "none" : "");
+	}
+	if (ln->num_refs > 0) {
+		printf("References:\n");
+		printf("%18s %-6s %6s %-32s %14s %14s", "Reference", "", "Loop", " Address", "Accesses", "Misses");
+		if (ln->recorded) printf(" %16s %14s", "Actual Accesses", "Actual Misses");
+		printf("\n");
+	}
+	for (unsigned long j = 0; j < ln->num_refs; j++) {
+		struct ref *r = &ln->refs[j];
+		unsigned long pc = ln->instr_lower + r->index * 4;
+
+		printf("%#18lx %-6s ", pc, instr_name(ln->instrs->instructions[r->index].inst_no));
+		if (r->depth == 0) printf("%6s", "-");
+		else               printf("%6ld", r->loops[r->depth - 1]);
+		affine_print(r);
+		if (r->accesses < 0) printf(" %14s", "?");
+		else                 printf(" %14ld", r->accesses);
+		if (r->misses < 0) printf(" %14s", "?");
+		else               printf(" %14ld", r->misses);
+		if (ln->recorded) {
+			struct pc_stat s = pc_stats_get(ln->actual, pc);
+
+			printf(" %16lu %14lu", s.accesses, s.misses);
+		}
+		printf("\n");
+		if (r->accesses < 0 || r->misses < 0) complete = 0;
+		else {
+			accesses += r->accesses;
+			misses += r->misses;
+		}
+	}
+	printf("Predicted%s: Accesses: %ld, Misses: %ld, Miss Rate: %.2f%%\n", complete ? "" : " (known references)",
+		accesses, misses, accesses == 0 ? 0.0 : ((double)misses / (double)accesses) * 100.0);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <instructions.h>
+
+/*
+ * Static cache analysis of simple affine loop nests: predict each load/store's cache misses
+ * from the program's instructions, without executing them.
+ *
+ * The loops are the backward conditional branches (do-while loops, as compilers emit them),
+ * which must nest properly. The analysis walks the program once from its entry, tracking
+ * each register's value as an affine function of the iteration numbers of the enclosing
+ * loops, `c0 + c1*i1 + ...`: constants, `lui`/`auipc`/`addi`/`add`/`sub`/`slli` of them, and
+ * the induction variables, the registers a loop only changes with `addi r,r,c` (in its body
+ * or in its inner loops). A loop's trip count comes from its branch comparing an induction variable
+ * with a constant. Forward branches are assumed not taken, and the walk stops at calls, at
+ * indirect jumps, and at the exit `ecall`.
+ *
+ * Each load/store whose address is affine gets its accesses (the product of the trip counts
+ * around it) and its misses, from the innermost loop out: a stride under a line size reuses
+ * lines spatially, and a loop that doesn't move a reference (or moves it less than what its
+ * inner loops touch) reuses them temporally if everything its body touches fits in the
+ * cache, by capacity and per set. References to the same line at the same strides share
+ * their misses. Reuse between separate loop nests is not counted.
+ */
+
+/* Define this as you'd like in your .c file. */
+struct loopnest;
+
+/*
+ * Analyze a program, for a cache geometry.
+ *
+ * @param instrs The program's instructions.
+ * @param instr_lower The address of the first instruction.
+ * @param entry The address execution starts at.
+ * @param num_lines The lines of the cache.
+ * @param num_sets The sets of the cache.
+ * @return The analysis, or NULL on failure.
+ */
+struct loopnest *loopnest_analyze(struct instructions *instrs, unsigned long instr_lower, unsigned long entry,
+				  unsigned long num_lines, unsigned long num_sets);
+void loopnest_free(struct loopnest *ln);
+
+/*
+ * Count one access of the cache the predictions are for, to print the actual accesses and
+ * misses of each reference next to the predicted ones.
+ *
+ * @param ln The analysis.
+ * @param pc The address of the load/store.
+ * @param miss Non-zero if it missed.
+ */
+void loopnest_record(struct loopnest *ln, unsigned long pc, int miss);
+
+/* Forget the actual accesses and misses recorded so far */
+void loopnest_stats_reset(struct loopnest *ln);
+
+/*
+ * Print the loops (trip counts and induction variables) and, for each load/store, its
+ * address as a function of the loops' iterations and its predicted accesses and misses,
+ * with the actual ones if any were recorded.
+ */
+void loopnest_print(struct loopnest *ln);
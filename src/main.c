@@ -4,9 +4,11 @@
 */
 
 #include <processor.h>
+#include <prefetch.h>
 
 #include <stdio.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -28,14 +30,325 @@ find_instructions(char *prog)
 
 #define PROG_SZ_MAX (1024 * 16)
 
+/* Read a whole program (at most PROG_SZ_MAX - 1 bytes) from `fd` into `program` */
+static void
+program_read(int fd, char *program)
+{
+	int ret, read_amnt = 0;
+
+	while ((ret = read(fd, program + read_amnt, PROG_SZ_MAX - 1 - read_amnt)) != 0) {
+		if (ret < 0) err("Cannot read the program.\n");
+		read_amnt += ret;
+	}
+	program[read_amnt] = '\0';
+}
+
+/*
+ * Parse a program's instructions, and its addresses into `cfg`, and
+ * validate that they print back the same.
+ */
+static struct instructions *
+program_parse(char *program, struct configuration *cfg)
+{
+	struct instructions *instrs = instructions_parse(program, cfg);
+
+	if (!instrs) err("Cannot parse program.\n");
+	/* Validate that we parsed it correctly (not expected of students) */
+	if (strcmp(find_instructions(program), stringify_program(instrs)) != 0) {
+		char **p, **s;
+		int p_lines, s_lines, i;
+
+		p = lines(find_instructions(program), &p_lines);
+		s = lines(stringify_program(instrs), &s_lines);
+		assert(p_lines == s_lines);
+		fprintf(stderr, "Instruction parse failed. Differences:\n");
+		for (i = 0; i < s_lines; i++) {
+			if (strcmp(p[i], s[i]) != 0) {
+				fprintf(stderr, "line %d, input program:\n%s\nprocessed instructions:\n%s\n",
+					i, p[i], s[i]);
+			}
+		}
+		exit(-1);
+	}
+
+	return instrs;
+}
+
+/*
+ * Parse `--corun=<file>[,<file>...]` and `--llc-ways=<mask>[,<mask>...]`
+ * into the programs to co-schedule and their way masks. Returns 1 if the
+ * argument was one of them, 0 otherwise.
+ */
+static int
+parse_corun(char *arg, struct configuration *cfg)
+{
+	char *tok, *end;
+
+	if (strncmp(arg, "--corun=", 8) == 0) {
+		cfg->num_programs = 0;
+		for (tok = strtok(arg + 8, ","); tok; tok = strtok(NULL, ",")) {
+			if (cfg->num_programs == COSCHED_PROGRAMS_MAX) err("Too many programs to co-schedule.\n");
+			cfg->programs[cfg->num_programs++] = tok;
+		}
+		if (cfg->num_programs == 0) err("Invalid --corun, expected <file>[,<file>...].\n");
+		return 1;
+	}
+	if (strncmp(arg, "--llc-ways=", 11) == 0) {
+		arg += 11;
+		cfg->num_way_masks = 0;
+		do {
+			if (cfg->num_way_masks == COSCHED_PROGRAMS_MAX) err("Too many way masks.\n");
+			cfg->way_masks[cfg->num_way_masks++] = strtoul(arg, &end, 0);
+			if (end == arg) err("Invalid --llc-ways, expected <mask>[,<mask>...].\n");
+			arg = end;
+		} while (*arg++ == ',');
+		if (arg[-1] != '\0') err("Invalid --llc-ways, expected <mask>[,<mask>...].\n");
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Parse `--cache-values=<lines>,<sets>[:<lines>,<sets>...]` into the
+ * list of cache configurations. Returns the number of configurations,
+ * or 0 if the argument isn't a cache configuration.
+ */
+static unsigned long
+parse_cache_values(char *arg, struct configuration *cfg)
+{
+	unsigned long n = 0, lines, sets;
+	int len;
+
+	if (strncmp(arg, "--cache-values=", 15) != 0) return 0;
+	arg += 15;
+	while (sscanf(arg, "%lu,%lu%n", &lines, &sets, &len) == 2) {
+		if (n == CACHE_CONFIGS_MAX) err("Too many cache configurations.\n");
+		cfg->cache_config_lines[n] = lines;
+		cfg->cache_config_sets[n]  = sets;
+		n++;
+		arg += len;
+		if (*arg != ':') break;
+		arg++;
+	}
+	if (n == 0 || *arg != '\0' || arg[-1] == ':') err("Invalid --cache-values, expected <lines>,<sets>[:<lines>,<sets>...].\n");
+	cfg->num_cache_configs    = n;
+	cfg->cache_tot_cachelines = cfg->cache_config_lines[0];
+	cfg->cache_sets           = cfg->cache_config_sets[0];
+
+	return n;
+}
+
+/*
+ * Parse `--ilp[=<window>[,<window>...]]` into the instruction windows
+ * of the ILP limit study, 0 standing for an unlimited one. Returns the
+ * number of windows, or 0 if the argument isn't an ILP study.
+ */
+static unsigned long
+parse_ilp_windows(char *arg, struct configuration *cfg)
+{
+	unsigned long defaults[] = { 32, 128, 512, 0 };
+	unsigned long n = 0, window;
+	int len;
+
+	if (strcmp(arg, "--ilp") == 0) {
+		memcpy(cfg->ilp_windows, defaults, sizeof(defaults));
+		return cfg->num_ilp_windows = sizeof(defaults) / sizeof(defaults[0]);
+	}
+	if (strncmp(arg, "--ilp=", 6) != 0) return 0;
+	arg += 6;
+	while (sscanf(arg, "%lu%n", &window, &len) == 1) {
+		if (n == ILP_WINDOWS_MAX) err("Too many ILP windows.\n");
+		cfg->ilp_windows[n++] = window;
+		arg += len;
+		if (*arg != ',') break;
+		arg++;
+	}
+	if (n == 0 || *arg != '\0') err("Invalid --ilp, expected <window>[,<window>...].\n");
+
+	return cfg->num_ilp_windows = n;
+}
+
+/* A DRAM with the configured geometry and timings */
+static struct dram *
+dram_from_config(struct configuration *cfg)
+{
+	struct dram_config dc = {
+		.banks    = cfg->dram_banks,
+		.row_size = cfg->dram_row_size,
+		.t_rcd    = cfg->t_rcd,
+		.t_cas    = cfg->t_cas,
+		.t_rp     = cfg->t_rp,
+		.t_burst  = cfg->t_burst,
+		.policy   = cfg->dram_policy,
+		.mapping  = cfg->dram_mapping,
+	};
+	struct dram *d = dram_alloc(&dc);
+
+	if (!d) err("Cannot allocate the DRAM.\n");
+	return d;
+}
+
+/*
+ * Set up the memory models the configuration asks for around the
+ * processor's first cache: the other cache configurations, their
+ * victim caches, prefetchers and worker threads, the stack-distance
+ * analyzer, the coherent private caches, the per-instruction and
+ * per-object statistics, the heatmap, the DRAM, and the virtual memory.
+ */
+static void
+processor_models_alloc(struct processor *p)
+{
+	struct configuration *cfg = &p->cfg;
+	unsigned long i;
+
+	if (!p->cache) err("Cannot allocate the cache.\n");
+	for (i = 1; i < cfg->num_cache_configs; i++) {
+		p->caches[i] = cache_allocate(cfg->cache_config_lines[i], cfg->cache_config_sets[i]);
+		if (!p->caches[i]) err("Cannot allocate the cache.\n");
+		p->num_caches++;
+	}
+	/* Each cache gets its own victim cache and prefetcher */
+	for (i = 0; i < p->num_caches; i++) {
+		if (cache_set_victim(p->caches[i], cfg->victim_entries, cfg->victim_mode)) err("Cannot allocate the victim cache.\n");
+		if (cfg->prefetch_type != PREFETCH_NONE) {
+			struct prefetcher *pf = prefetcher_alloc(cfg->prefetch_type, cfg->prefetch_degree, cfg->prefetch_distance);
+
+			if (!pf) err("Cannot allocate the prefetcher.\n");
+			cache_set_prefetcher(p->caches[i], pf, cfg->prefetch_latency);
+		}
+		if (cache_set_threads(p->caches[i], cfg->cache_threads)) err("Cannot split the cache between threads.\n");
+	}
+	if (cfg->mrc) {
+		p->sd = cfg->mrc_sample_rate > 0 ? stack_distance_alloc_sampled(cfg->mrc_sample_rate, cfg->mrc_sample_lines) : stack_distance_alloc();
+		if (!p->sd) err("Cannot allocate the stack distance analyzer.\n");
+	}
+	if (cfg->pc_stats) {
+		/* Threads simulating the cache only know the outcome of an access later */
+		if (cfg->cache_threads > 1) err("--pc-stats cannot be combined with --cache-threads.\n");
+		if (!(p->pc_stats = pc_stats_alloc())) err("Cannot allocate the pc statistics.\n");
+	}
+	if (cfg->coherence_cores) {
+		p->coherence = coherence_alloc(cfg->coherence_protocol, cfg->coherence_cores, cfg->cache_tot_cachelines, cfg->cache_sets);
+		if (!p->coherence) err("Cannot allocate the coherence model.\n");
+	}
+	if (cfg->heatmap_out) {
+		if (cfg->cache_threads > 1) err("--heatmap cannot be combined with --cache-threads.\n");
+		if (!(p->heatmap = heatmap_open(cfg->heatmap_out, cfg->heatmap_interval, cfg->heatmap_granularity))) err("Cannot create the heatmap file.\n");
+	}
+	if (cfg->symbol_file || cfg->num_regions) {
+		if (cfg->cache_threads > 1) err("--symbols and --region cannot be combined with --cache-threads.\n");
+		if (!(p->regions = regions_alloc())) err("Cannot allocate the data regions.\n");
+		if (cfg->symbol_file && regions_load_symbols(p->regions, cfg->symbol_file, cfg->memory_sz ? cfg->instr_upper + cfg->memory_sz : 0) < 0) {
+			err("Cannot load the symbol file.\n");
+		}
+		for (i = 0; i < cfg->num_regions; i++) {
+			char name[64];
+			unsigned long start, size;
+
+			if (sscanf(cfg->region_args[i], "%63[^:]:%li:%li", name, &start, &size) != 3 ||
+			    regions_add(p->regions, name, start, size) != 0) {
+				err("Invalid --region, expected <name>:<start>:<size>.\n");
+			}
+		}
+	}
+	/* The timing models send their misses to their own DRAM, in their own cycles */
+	if (cfg->dram_banks && (cfg->trace_in || !(cfg->pipeline_width || cfg->ooo_rob))) {
+		if (cfg->cache_threads > 1) err("--dram cannot be combined with --cache-threads.\n");
+		p->dram = dram_from_config(cfg);
+	}
+	if (cfg->vm) {
+		struct vm_config vc = {
+			.lower         = cfg->instr_lower,
+			.upper         = cfg->instr_upper + cfg->memory_sz,
+			.page_size     = cfg->vm_page_size,
+			.itlb_entries  = cfg->itlb_entries,
+			.itlb_ways     = cfg->itlb_ways,
+			.dtlb_entries  = cfg->dtlb_entries,
+			.dtlb_ways     = cfg->dtlb_ways,
+			.l2tlb_entries = cfg->l2tlb_entries,
+			.l2tlb_ways    = cfg->l2tlb_ways,
+			.l2_latency    = cfg->l2tlb_latency,
+			.hit_latency   = cfg->hit_latency,
+			.miss_latency  = cfg->miss_latency,
+		};
+
+		/* The page tables are built for a program's image, and walked as it runs */
+		if (cfg->trace_in) err("--vm cannot be combined with --trace-in.\n");
+		if (cfg->model_thread || cfg->cache_threads > 1) err("--vm cannot be combined with --model-thread or --cache-threads.\n");
+		if (!(p->vm = vm_alloc(&vc, p->cache))) err("Cannot allocate the virtual memory.\n");
+	}
+}
+
+/*
+ * Hand the memory models over to their own thread, once they are all
+ * set up (including the trace writer).
+ */
+static void
+processor_models_start(struct processor *p)
+{
+	if (p->cfg.model_thread && !(p->model_thread = model_thread_start(p))) err("Cannot start the model thread.\n");
+}
+
+/*
+ * Co-schedule the programs of `--corun`, each on a processor with its
+ * own registers, memory, private L1 and memory models, in front of one
+ * shared cache.
+ */
+static void
+corun(struct configuration *cfg)
+{
+	struct processor *ps[COSCHED_PROGRAMS_MAX];
+	struct cosched_config cc = {
+		.num_programs = cfg->num_programs,
+		.cache_lines  = cfg->llc_lines,
+		.cache_sets   = cfg->llc_sets,
+		.quantum      = cfg->quantum,
+	};
+	struct cosched *cs;
+	char program[PROG_SZ_MAX];
+	unsigned long i;
+
+	if (cfg->num_way_masks && cfg->num_way_masks != cfg->num_programs) err("--llc-ways needs one mask per program.\n");
+	if (cfg->quantum == 0) err("--quantum must be at least one instruction.\n");
+	/* The programs take turns on this thread, and share a cache */
+	if (cfg->trace_in || cfg->trace_out || cfg->model_thread || cfg->cache_threads > 1) {
+		err("--corun cannot be combined with --trace-in, --trace-out, --model-thread or --cache-threads.\n");
+	}
+	if (cfg->pipeline_width || cfg->ooo_rob) err("--corun cannot be combined with --pipeline or --ooo.\n");
+	memcpy(cc.way_masks, cfg->way_masks, sizeof(cc.way_masks));
+	if (!(cs = cosched_alloc(&cc))) err("Cannot allocate the shared cache.\n");
+	for (i = 0; i < cfg->num_programs; i++) {
+		struct configuration pcfg = *cfg;
+		struct instructions *instrs;
+		int fd = open(cfg->programs[i], O_RDONLY);
+
+		if (fd < 0) err("Cannot open a program to co-schedule.\n");
+		program_read(fd, program);
+		close(fd);
+		instrs = program_parse(program, &pcfg);
+		/* The program's own caches are its L1 */
+		pcfg.print_instrs = 0;
+		pcfg.num_cache_configs = 1;
+		pcfg.cache_tot_cachelines = pcfg.cache_config_lines[0] = cfg->l1_lines;
+		pcfg.cache_sets = pcfg.cache_config_sets[0] = cfg->l1_sets;
+		ps[i] = processor_alloc(&pcfg, instrs, registers_alloc(pcfg.entry_address), memory_alloc(pcfg.memory_sz), cache_allocate(cfg->l1_lines, cfg->l1_sets));
+		ps[i]->cosched = cs;
+		ps[i]->program = i;
+		processor_models_alloc(ps[i]);
+	}
+	processor_corun(ps, cfg->num_programs, cs);
+	for (i = 0; i < cfg->num_programs; i++) heatmap_close(ps[i]->heatmap);
+	cosched_free(cs);
+}
+
 int
 main(int argc, char *argv[])
 {
 	char program[PROG_SZ_MAX];
-	int ret, read_amnt = 0;
 	struct instructions *instrs;
 	struct processor *p;
 	struct configuration cfg;
+	struct loopnest *ln = NULL;
 	int i;
 
 	/* Default configuration values */
@@ -44,53 +357,269 @@ main(int argc, char *argv[])
 		.print_regs   = 1,
 		.print_cache  = 1,
 		.cache_tot_cachelines = 1,
-		.cache_sets = 1
+		.cache_sets = 1,
+		.num_cache_configs = 1,
+		.cache_config_lines = { 1 },
+		.cache_config_sets = { 1 },
+		.prefetch_type = PREFETCH_NONE,
+		.prefetch_degree = 1,
+		.prefetch_distance = 1,
+		.prefetch_latency = 0,
+		.heatmap_interval = 1000,
+		.heatmap_granularity = 64,
+		.stats_out = "stats.csv",
+		.branch_penalty = 2,
+		.forwarding = 1,
+		.hit_latency = 1,
+		.miss_latency = 50,
+		.bpred_bits = 12,
+		.btb_entries = 512,
+		.ras_entries = 16,
+		.ooo_width = 4,
+		.ooo_rename = 64,
+		.ooo_lq = 32,
+		.ooo_sq = 32,
+		.alu_latency = 1,
+		.branch_latency = 1,
+		.dram_row_size = 8192,
+		.t_rcd = 20,
+		.t_cas = 20,
+		.t_rp = 20,
+		.t_burst = 4,
+		.itlb_entries = 64,
+		.itlb_ways = 4,
+		.dtlb_entries = 64,
+		.dtlb_ways = 4,
+		.l2tlb_entries = 1024,
+		.l2tlb_ways = 8,
+		.l2tlb_latency = 7,
+		.quantum = 1000,
+		.l1_lines = 64,
+		.l1_sets = 16,
+		.llc_lines = 1024,
+		.llc_sets = 64
 	};
 
 	/* Parse the command-line arguments */
 	for (i = 1; i < argc; i++) {
-		unsigned long cache_num_lines, cache_sets;
+		char model_name[16];
 
 		if (strcmp(argv[i], "--no-print-instr") == 0) cfg.print_instrs = 0;
 		if (strcmp(argv[i], "--no-print-regs") == 0)  cfg.print_regs   = 0;
 		if (strcmp(argv[i], "--no-print-cache") == 0) cfg.print_cache  = 0;
-		if (sscanf(argv[i], "--cache-values=%ld,%ld", &cache_num_lines, &cache_sets) == 2) {
-			cfg.cache_sets = cache_sets;
-			cfg.cache_tot_cachelines = cache_num_lines;
+		if (strcmp(argv[i], "--mrc") == 0)            cfg.mrc          = 1;
+		if (strncmp(argv[i], "--trace-out=", 12) == 0) cfg.trace_out = argv[i] + 12;
+		if (strncmp(argv[i], "--trace-in=", 11) == 0)  cfg.trace_in  = argv[i] + 11;
+		if (strcmp(argv[i], "--trace-compress") == 0)  cfg.trace_compress = 1;
+		if (sscanf(argv[i], "--mrc-sample=%lf,%lu", &cfg.mrc_sample_rate, &cfg.mrc_sample_lines) >= 1) cfg.mrc = 1;
+		if (parse_cache_values(argv[i], &cfg)) {
+			/* The shared cache of --corun too */
+			cfg.llc_lines = cfg.cache_tot_cachelines;
+			cfg.llc_sets  = cfg.cache_sets;
+		}
+		if (sscanf(argv[i], "--prefetch=%15[a-z],%lu,%lu", model_name, &cfg.prefetch_degree, &cfg.prefetch_distance) >= 1) {
+			cfg.prefetch_type = prefetch_type_parse(model_name);
+			if (cfg.prefetch_type == PREFETCH_NONE && strcmp(model_name, "none") != 0) err("Unknown prefetcher, use nextline, stride, or stream.\n");
+			if (cfg.prefetch_degree == 0 || cfg.prefetch_degree > PREFETCH_DEGREE_MAX) err("Invalid --prefetch degree, use 1 to 16.\n");
+		}
+		sscanf(argv[i], "--prefetch-latency=%lu", &cfg.prefetch_latency);
+		if (sscanf(argv[i], "--victim-cache=%lu", &cfg.victim_entries) == 1) cfg.victim_mode = VICTIM_CACHE;
+		if (sscanf(argv[i], "--miss-cache=%lu", &cfg.victim_entries) == 1)   cfg.victim_mode = MISS_CACHE;
+		sscanf(argv[i], "--cache-threads=%lu", &cfg.cache_threads);
+		if (strcmp(argv[i], "--model-thread") == 0) cfg.model_thread = 1;
+		if (strcmp(argv[i], "--pc-stats") == 0) cfg.pc_stats = 10;
+		sscanf(argv[i], "--pc-stats=%lu", &cfg.pc_stats);
+		if (strncmp(argv[i], "--heatmap=", 10) == 0) {
+			char *opts = strchr(argv[i] + 10, ',');
+
+			cfg.heatmap_out = argv[i] + 10;
+			if (opts) {
+				*opts = '\0';
+				sscanf(opts + 1, "%lu,%lu", &cfg.heatmap_interval, &cfg.heatmap_granularity);
+			}
+		}
+		sscanf(argv[i], "--stats-interval=%lu", &cfg.stats_interval);
+		if (strncmp(argv[i], "--stats-out=", 12) == 0) cfg.stats_out = argv[i] + 12;
+		if (sscanf(argv[i], "--coherence=%15[a-z],%lu", model_name, &cfg.coherence_cores) >= 1) {
+			int protocol = coherence_protocol_parse(model_name);
+
+			if (protocol < 0) err("Unknown coherence protocol, use mesi or moesi.\n");
+			cfg.coherence_protocol = protocol;
+			if (!cfg.coherence_cores) cfg.coherence_cores = 4;
+		}
+		if (strcmp(argv[i], "--pipeline") == 0) cfg.pipeline_width = 1;
+		sscanf(argv[i], "--pipeline=%lu", &cfg.pipeline_width);
+		sscanf(argv[i], "--branch-penalty=%lu", &cfg.branch_penalty);
+		if (strcmp(argv[i], "--no-forwarding") == 0) cfg.forwarding = 0;
+		sscanf(argv[i], "--mem-latency=%lu,%lu", &cfg.hit_latency, &cfg.miss_latency);
+		if (strcmp(argv[i], "--bpred") == 0) cfg.bpred_types = (1UL << BPRED_COUNT) - 1;
+		if (strncmp(argv[i], "--bpred=", 8) == 0) {
+			long types = bpred_parse(argv[i] + 8);
+
+			if (types <= 0) err("Unknown branch predictor, use static, bimodal, gshare, tage, btb, or ras.\n");
+			cfg.bpred_types = types;
+		}
+		sscanf(argv[i], "--bpred-bits=%lu", &cfg.bpred_bits);
+		sscanf(argv[i], "--btb-entries=%lu", &cfg.btb_entries);
+		sscanf(argv[i], "--ras-entries=%lu", &cfg.ras_entries);
+		if (strcmp(argv[i], "--ooo") == 0) cfg.ooo_rob = 128;
+		sscanf(argv[i], "--ooo=%lu,%lu", &cfg.ooo_rob, &cfg.ooo_width);
+		sscanf(argv[i], "--ooo-rename=%lu", &cfg.ooo_rename);
+		sscanf(argv[i], "--ooo-lsq=%lu,%lu", &cfg.ooo_lq, &cfg.ooo_sq);
+		sscanf(argv[i], "--fu-latency=%lu,%lu", &cfg.alu_latency, &cfg.branch_latency);
+		sscanf(argv[i], "--mshrs=%lu", &cfg.mshrs);
+		if (strcmp(argv[i], "--dram") == 0) cfg.dram_banks = 8;
+		sscanf(argv[i], "--dram=%lu,%lu", &cfg.dram_banks, &cfg.dram_row_size);
+		sscanf(argv[i], "--dram-timing=%lu,%lu,%lu,%lu", &cfg.t_rcd, &cfg.t_cas, &cfg.t_rp, &cfg.t_burst);
+		if (sscanf(argv[i], "--dram-policy=%15[a-z]", model_name) == 1) {
+			int policy = dram_policy_parse(model_name);
+
+			if (policy < 0) err("Unknown DRAM page policy, use open or closed.\n");
+			cfg.dram_policy = policy;
+		}
+		if (strcmp(argv[i], "--vm") == 0) cfg.vm = 1;
+		if (sscanf(argv[i], "--vm=%15[a-z0-9]", model_name) == 1) {
+			int size = vm_page_size_parse(model_name);
+
+			if (size < 0) err("Unknown page size, use 4k or 2m.\n");
+			cfg.vm = 1;
+			cfg.vm_page_size = size;
+		}
+		parse_ilp_windows(argv[i], &cfg);
+		sscanf(argv[i], "--itlb=%lu,%lu", &cfg.itlb_entries, &cfg.itlb_ways);
+		sscanf(argv[i], "--dtlb=%lu,%lu", &cfg.dtlb_entries, &cfg.dtlb_ways);
+		sscanf(argv[i], "--l2tlb=%lu,%lu,%lu", &cfg.l2tlb_entries, &cfg.l2tlb_ways, &cfg.l2tlb_latency);
+		if (sscanf(argv[i], "--dram-map=%15[a-z]", model_name) == 1) {
+			int mapping = dram_mapping_parse(model_name);
+
+			if (mapping < 0) err("Unknown DRAM address mapping, use rbc, rcb, or xor.\n");
+			cfg.dram_mapping = mapping;
+		}
+		parse_corun(argv[i], &cfg);
+		sscanf(argv[i], "--quantum=%lu", &cfg.quantum);
+		sscanf(argv[i], "--l1=%lu,%lu", &cfg.l1_lines, &cfg.l1_sets);
+		if (strcmp(argv[i], "--predict") == 0)        cfg.predict = 1;
+		if (strcmp(argv[i], "--predict=verify") == 0) cfg.predict = 2;
+		if (strcmp(argv[i], "--fast-forward") == 0)   cfg.fast_forward = 1;
+		if (strncmp(argv[i], "--symbols=", 10) == 0) cfg.symbol_file = argv[i] + 10;
+		if (strncmp(argv[i], "--region=", 9) == 0) {
+			if (cfg.num_regions == REGION_ARGS_MAX) err("Too many --region ranges.\n");
+			cfg.region_args[cfg.num_regions++] = argv[i] + 9;
 		}
 	}
 
-	/* Read in the program */
-	while ((ret = read(STDIN_FILENO, program + read_amnt, PROG_SZ_MAX - read_amnt)) != 0) {
-		if (ret < 0) err("Cannot read program from stdin.\n");
-		read_amnt += ret;
+	/* A trace holds no region of interest to fast-forward to */
+	if (cfg.fast_forward && cfg.trace_in) err("--fast-forward cannot be combined with --trace-in.\n");
+
+	/* Replaying a trace only needs the memory models, not a program */
+	if (cfg.trace_in) {
+		struct trace_reader *tr = trace_reader_open(cfg.trace_in);
+
+		if (!tr) err("Cannot open the trace file.\n");
+		p = processor_alloc(&cfg, NULL, NULL, NULL, cache_allocate(cfg.cache_tot_cachelines, cfg.cache_sets));
+		processor_models_alloc(p);
+		processor_models_start(p);
+		if (processor_replay(p, tr) < 0) err("Cannot replay the trace.\n");
+		trace_reader_close(tr);
+		heatmap_close(p->heatmap);
+
+		return 0;
 	}
 
-	/* Parse the instructions */
-	instrs = instructions_parse(program, &cfg);
-	if (!instrs) err("Cannot parse program.\n");
-	/* Validate that we parsed it correctly (not expected of students) */
-	if (strcmp(find_instructions(program), stringify_program(instrs)) != 0) {
-		char **p, **s;
-		int p_lines, s_lines, i;
+	/* Co-scheduling runs the programs it lists instead of the one on stdin */
+	if (cfg.num_programs) {
+		corun(&cfg);
 
-		p = lines(find_instructions(program), &p_lines);
-		s = lines(stringify_program(instrs), &s_lines);
-		assert(p_lines == s_lines);
-		fprintf(stderr, "Instruction parse failed. Differences:\n");
-		for (i = 0; i < s_lines; i++) {
-			if (strcmp(p[i], s[i]) != 0) {
-				fprintf(stderr, "line %d, input program:\n%s\nprocessed instructions:\n%s\n",
-					i, p[i], s[i]);
-			}
+		return 0;
+	}
+
+	/* Read in the program, and parse the instructions */
+	program_read(STDIN_FILENO, program);
+	instrs = program_parse(program, &cfg);
+	if (cfg.predict) {
+		ln = loopnest_analyze(instrs, cfg.instr_lower, cfg.entry_address, cfg.cache_tot_cachelines, cfg.cache_sets);
+
+		if (!ln) err("Cannot analyze the program's loop nests.\n");
+		/* Predicting alone doesn't need to run the program */
+		if (cfg.predict == 1) {
+			loopnest_print(ln);
+			loopnest_free(ln);
+
+			return 0;
 		}
-		exit(-1);
 	}
-	
+
 	/* Allocate a processor with the configuration and instructions */
 	p = processor_alloc(&cfg, instrs, registers_alloc(cfg.entry_address), memory_alloc(cfg.memory_sz), cache_allocate(cfg.cache_tot_cachelines, cfg.cache_sets));
+	processor_models_alloc(p);
+	p->loopnest = ln;
+	if (cfg.trace_out && !(p->trace = trace_writer_open(cfg.trace_out, cfg.trace_compress))) err("Cannot create the trace file.\n");
+	if (cfg.pipeline_width) {
+		struct pipeline_config pc = {
+			.width          = cfg.pipeline_width,
+			.branch_penalty = cfg.branch_penalty,
+			.hit_latency    = cfg.hit_latency,
+			.miss_latency   = cfg.miss_latency,
+			.forwarding     = cfg.forwarding,
+			.mshrs          = cfg.mshrs,
+		};
+
+		/* Each instruction's timing needs the outcome of its access right away */
+		if (cfg.model_thread || cfg.cache_threads > 1) err("--pipeline cannot be combined with --model-thread or --cache-threads.\n");
+		if (!(p->pipeline = pipeline_alloc(&pc))) err("Cannot allocate the pipeline model.\n");
+		if (cfg.dram_banks) pipeline_set_dram(p->pipeline, dram_from_config(&cfg));
+	}
+	if (cfg.ooo_rob) {
+		struct ooo_config oc = {
+			.rob_size         = cfg.ooo_rob,
+			.width            = cfg.ooo_width,
+			.rename_regs      = cfg.ooo_rename,
+			.lq_size          = cfg.ooo_lq,
+			.sq_size          = cfg.ooo_sq,
+			.alu_latency      = cfg.alu_latency,
+			.branch_latency   = cfg.branch_latency,
+			.hit_latency      = cfg.hit_latency,
+			.miss_latency     = cfg.miss_latency,
+			.redirect_penalty = cfg.branch_penalty,
+			.mshrs            = cfg.mshrs,
+		};
+
+		if (cfg.model_thread || cfg.cache_threads > 1) err("--ooo cannot be combined with --model-thread or --cache-threads.\n");
+		if (!(p->ooo = ooo_alloc(&oc))) err("Cannot allocate the out-of-order core model.\n");
+		if (cfg.dram_banks) ooo_set_dram(p->ooo, dram_from_config(&cfg));
+	}
+	if (cfg.num_ilp_windows) {
+		struct ilp_config ic = {
+			.num_windows    = cfg.num_ilp_windows,
+			.alu_latency    = cfg.alu_latency,
+			.branch_latency = cfg.branch_latency,
+			.hit_latency    = cfg.hit_latency,
+			.miss_latency   = cfg.miss_latency,
+		};
+
+		memcpy(ic.windows, cfg.ilp_windows, sizeof(ic.windows));
+		if (cfg.model_thread || cfg.cache_threads > 1) err("--ilp cannot be combined with --model-thread or --cache-threads.\n");
+		if (!(p->ilp = ilp_alloc(&ic))) err("Cannot allocate the ILP limit study.\n");
+	}
+	if (cfg.mshrs && !cfg.pipeline_width && !cfg.ooo_rob) err("--mshrs needs a timing model, --pipeline or --ooo.\n");
+	if (cfg.bpred_types && !(p->bpred = bpred_alloc(cfg.bpred_types, cfg.bpred_bits, cfg.btb_entries, cfg.ras_entries))) {
+		err("Cannot allocate the branch predictors.\n");
+	}
+	if (cfg.stats_interval) {
+		char *ext = strrchr(cfg.stats_out, '.');
+		int json = ext && (strcmp(ext, ".json") == 0 || strcmp(ext, ".jsonl") == 0);
+
+		/* The records read the cache as each interval ends, it can't lag behind */
+		if (cfg.model_thread) err("--stats-interval cannot be combined with --model-thread.\n");
+		if (!(p->interval_stats = interval_stats_open(cfg.stats_out, cfg.stats_interval, json))) err("Cannot create the statistics file.\n");
+	}
+	processor_models_start(p);
 	/* Emulate the processor and execute the program! */
 	processor_emulate(p);
+	processor_models_sync(p);
+	trace_writer_close(p->trace);
+	heatmap_close(p->heatmap);
+	interval_stats_close(p->interval_stats, p->cache);
 
 	return 0;
 }
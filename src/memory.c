@@ -78,6 +78,54 @@ char memory_getbyte(struct memory *m, unsigned long addr) {
 }
 
 
+void processor_memory_access(struct processor *p, unsigned long pc, unsigned long addr, unsigned long size, int is_store) {
+    p->mem_addr = addr;
+    if (!p->measuring) return;
+    if (p->model_thread) {
+        model_thread_push(p->model_thread, p->num_instrs, p->core, pc, addr, size, is_store);
+        return;
+    }
+    p->model_time = p->num_instrs;
+    p->model_core = p->core;
+    // Only set here: the model thread mustn't write what the emulator's thread reads
+    p->mem_hit = processor_models_access(p, pc, addr, size, is_store);
+}
+
+
+int processor_models_access(struct processor *p, unsigned long pc, unsigned long addr, unsigned long size, int is_store) {
+    int mem_hit = -1;
+
+    // The page walks, if any, reach the cache before the access they translate
+    if (p->vm) vm_access(p->vm, addr);
+    // Every configured cache sees the same access, so one run covers all of them
+    for (unsigned long c = 0; c < p->num_caches; c++) {
+        int hit = cache_access_pc(p->caches[c], pc, addr);
+
+        // Misses are attributed to the instruction and the data object for the main cache
+        if (c != 0) continue;
+        mem_hit = hit;
+        if (p->pc_stats) pc_stats_record(p->pc_stats, pc, !hit);
+        if (p->regions) regions_record(p->regions, addr, !hit);
+        if (p->heatmap) heatmap_record(p->heatmap, p->model_time, addr, !hit);
+        if (p->dram && !hit) dram_access(p->dram, addr, p->model_time);
+        if (p->cosched && !hit) cosched_access(p->cosched, p->program, pc, addr);
+        if (p->loopnest) loopnest_record(p->loopnest, pc, !hit);
+    }
+    if (p->sd) stack_distance_access(p->sd, addr);
+    if (p->coherence) coherence_access(p->coherence, p->model_core, addr, size, is_store);
+    if (p->trace) {
+        struct trace_record r = { .pc = pc, .addr = addr, .size = size, .is_store = is_store, .core = p->model_core };
+
+        if (trace_write(p->trace, &r) != 0) {
+            fprintf(stderr, "ERROR: Failed to write the memory trace, tracing stopped.\n");
+            trace_writer_close(p->trace);
+            p->trace = NULL;
+        }
+    }
+    return mem_hit;
+}
+
+
 int processor_emulate_memops(struct processor *p, struct instruction *instr, enum exception *e) {
     // Validate Inputs & Check if it's a Memory Operation we handle
     if (!p || !p->rs || !p->mem || !instr || !e) {
@@ -159,7 +207,7 @@ int processor_emulate_memops(struct processor *p, struct instruction *instr, enu
     }
     
     if (is_memory_op) { // Only call for actual load/store instructions
-        cache_access(p->cache, effective_addr);
+        processor_memory_access(p, current_pc, effective_addr, access_size, is_store);
     }
 
     // Calculate Index into RAM Array
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <processor.h>
+#include "model_thread.h"
+#include "ring.h"
+
+// Words per access in the ring: time, pc, address, and the core, size and store flag
+#define MODEL_RECORD_WORDS 4
+// Accesses buffered before they are handed to the model thread
+#define MODEL_BATCH 256
+// Capacity of the ring, in accesses
+#define MODEL_RING_SIZE (64 * 1024)
+
+struct model_thread {
+	struct processor *p;
+	struct ring *ring;
+	unsigned long batch[MODEL_BATCH * MODEL_RECORD_WORDS]; // Not yet pushed to the ring
+	unsigned long batch_len;                               // In words
+	pthread_t thread;
+};
+
+
+static void *model_thread_run(void *arg) {
+	struct model_thread *mt = (struct model_thread *)arg;
+	unsigned long words[MODEL_BATCH * MODEL_RECORD_WORDS];
+	unsigned long n;
+
+	// Accesses are pushed whole, so every pop ends on a record boundary
+	while ((n = ring_pop_wait(mt->ring, words, MODEL_BATCH * MODEL_RECORD_WORDS)) > 0) {
+		for (unsigned long i = 0; i < n; i += MODEL_RECORD_WORDS) {
+			mt->p->model_time = words[i];
+			mt->p->model_core = words[i + 3] >> 8;
+			processor_models_access(mt->p, words[i + 1], words[i + 2], (words[i + 3] & 0xff) >> 1, words[i + 3] & 1);
+		}
+	}
+
+	return NULL;
+}
+
+
+struct model_thread *model_thread_start(struct processor *p) {
+	struct model_thread *mt = (struct model_thread *)calloc(1, sizeof(struct model_thread));
+
+	if (mt == NULL) {
+		perror("Failed to allocate model thread");
+		return NULL;
+	}
+	mt->p = p;
+	mt->ring = ring_alloc(MODEL_RING_SIZE * MODEL_RECORD_WORDS);
+	if (mt->ring == NULL) {
+		free(mt);
+		return NULL;
+	}
+	if (pthread_create(&mt->thread, NULL, model_thread_run, mt) != 0) {
+		fprintf(stderr, "Error: Failed to start the model thread.\n");
+		ring_free(mt->ring);
+		free(mt);
+		return NULL;
+	}
+
+	return mt;
+}
+
+
+void model_thread_push(struct model_thread *mt, unsigned long time, unsigned int core, unsigned long pc, unsigned long addr, unsigned long size, int is_store) {
+	unsigned long *rec = &mt->batch[mt->batch_len];
+
+	rec[0] = time;
+	rec[1] = pc;
+	rec[2] = addr;
+	rec[3] = ((unsigned long)core << 8) | (size << 1) | (is_store ? 1 : 0);
+	mt->batch_len += MODEL_RECORD_WORDS;
+	if (mt->batch_len == MODEL_BATCH * MODEL_RECORD_WORDS) {
+		ring_push(mt->ring, mt->batch, mt->batch_len);
+		mt->batch_len = 0;
+	}
+}
+
+
+void model_thread_join(struct model_thread *mt) {
+	if (mt == NULL) return;
+
+	if (mt->batch_len > 0) ring_push(mt->ring, mt->batch, mt->batch_len);
+	ring_close(mt->ring);
+	pthread_join(mt->thread, NULL);
+	ring_free(mt->ring);
+	free(mt);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+ * Run the memory models (caches, stack-distance analysis, trace recording) on a thread of
+ * their own. The emulator only queues each load/store into a lock-free ring, and the model
+ * thread replays them through `processor_models_access` in the same order, so functional
+ * execution and cache modeling overlap on two cores with unchanged results.
+ */
+
+struct processor;
+
+/* Define this as you'd like in your .c file. */
+struct model_thread;
+
+/*
+ * Start the model thread. From then on, only that thread may touch the processor's memory
+ * models, until `model_thread_join`.
+ *
+ * @param p The processor whose models the thread drives.
+ * @return The thread, or NULL on error.
+ */
+struct model_thread *model_thread_start(struct processor *p);
+
+/*
+ * Queue one load/store for the model thread (see `processor_memory_access`), with the
+ * instruction count at which it happened and the core that made it (the processor's
+ * `model_time` and `model_core` while it's modeled).
+ */
+void model_thread_push(struct model_thread *mt, unsigned long time, unsigned int core, unsigned long pc, unsigned long addr, unsigned long size, int is_store);
+
+/* Wait for the model thread to simulate every queued access, then stop and free it */
+void model_thread_join(struct model_thread *mt);
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "mshr.h"
+
+struct mshr_entry {
+	unsigned long block;        // The line being filled
+	unsigned long start, ready; // The fill, busy from start until ready
+};
+
+struct mshr {
+	unsigned long num_entries;
+	struct mshr_entry *entries;
+	unsigned long num_primary, num_secondary;
+	unsigned long num_full, full_cycles; // Misses that waited for an MSHR, and for how long
+	unsigned long busy_cycles, peak;     // The sum of the cycles each MSHR was busy, and the most busy at once
+};
+
+
+struct mshr *mshr_alloc(unsigned long num_entries) {
+	struct mshr *m;
+
+	if (num_entries == 0) {
+		fprintf(stderr, "Error: A cache needs at least one MSHR.\n");
+		return NULL;
+	}
+	m = (struct mshr *)calloc(1, sizeof(struct mshr));
+	if (m == NULL) {
+		perror("Failed to allocate MSHRs");
+		return NULL;
+	}
+	m->num_entries = num_entries;
+	m->entries = (struct mshr_entry *)calloc(num_entries, sizeof(struct mshr_entry));
+	if (m->entries == NULL) {
+		perror("Failed to allocate MSHRs");
+		free(m);
+		return NULL;
+	}
+
+	return m;
+}
+
+
+void mshr_free(struct mshr *m) {
+	if (m == NULL) return;
+	free(m->entries);
+	free(m);
+}
+
+
+enum mshr_result mshr_access(struct mshr *m, unsigned long block, unsigned long t, int miss, unsigned long latency,
+			     unsigned long *start, unsigned long *ready) {
+	struct mshr_entry *e, *first = &m->entries[0];
+	unsigned long busy = 0;
+
+	*start = *ready = t;
+	for (unsigned long i = 0; i < m->num_entries; i++) {
+		e = &m->entries[i];
+		if (e->ready > t && e->block == block) {
+			m->num_secondary++;
+			*ready = e->ready;
+			return MSHR_MERGED;
+		}
+		if (e->ready < first->ready) first = e;
+	}
+	if (!miss) return MSHR_HIT;
+
+	// The MSHR freed first, waiting for it if they are all busy
+	if (first->ready > t) {
+		m->num_full++;
+		m->full_cycles += first->ready - t;
+		*start = first->ready;
+	}
+	*first = (struct mshr_entry){ .block = block, .start = *start, .ready = *start + latency };
+	*ready = first->ready;
+	m->num_primary++;
+	m->busy_cycles += latency;
+	for (unsigned long i = 0; i < m->num_entries; i++) {
+		e = &m->entries[i];
+		if (e->start <= *start && e->ready > *start) busy++;
+	}
+	if (busy > m->peak) m->peak = busy;
+
+	return MSHR_ALLOCATED;
+}
+
+
+int mshr_pending(struct mshr *m, unsigned long block, unsigned long t) {
+	for (unsigned long i = 0; i < m->num_entries; i++) {
+		if (m->entries[i].ready > t && m->entries[i].block == block) return 1;
+	}
+	return 0;
+}
+
+
+unsigned long mshr_wait(struct mshr *m, unsigned long t) {
+	unsigned long first = m->entries[0].ready;
+
+	for (unsigned long i = 1; i < m->num_entries; i++) {
+		if (m->entries[i].ready < first) first = m->entries[i].ready;
+	}
+	return first > t ? first : t;
+}
+
+
+void mshr_stats_reset(struct mshr *m) {
+	if (m == NULL) return;
+	m->num_primary = m->num_secondary = 0;
+	m->num_full = m->full_cycles = 0;
+	m->busy_cycles = m->peak = 0;
+}
+
+
+void mshr_print(struct mshr *m, unsigned long cycles) {
+	if (m == NULL) return;
+	printf("MSHRs: %lu, Primary Misses: %lu, Secondary Misses (merged): %lu\n",
+		m->num_entries, m->num_primary, m->num_secondary);
+	printf("MSHR Occupancy: %.2f average, %lu peak, Full: %lu misses, waiting %lu cycles\n",
+		cycles == 0 ? 0.0 : (double)m->busy_cycles / (double)cycles, m->peak, m->num_full, m->full_cycles);
+}
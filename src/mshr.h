@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+ * Miss status holding registers: the misses a non-blocking cache has in flight, for timing
+ * models. Each miss takes an MSHR from the cycle its fill starts until the line arrives, and
+ * a miss finding all of them busy waits for the first to free up. An access to a line whose
+ * fill is still in flight is a secondary miss: it is merged into that line's MSHR and waits
+ * for the same fill, even if the cache (which updates as soon as a miss happens) says it hit.
+ */
+
+enum mshr_result {
+	MSHR_HIT,       // A hit, no fill of the line in flight
+	MSHR_MERGED,    // A secondary miss, waiting for the line's fill in flight
+	MSHR_ALLOCATED, // A primary miss, which took an MSHR
+};
+
+/* Define this as you'd like in your .c file. */
+struct mshr;
+
+struct mshr *mshr_alloc(unsigned long num_entries);
+void mshr_free(struct mshr *m);
+
+/*
+ * One access of a timing model.
+ *
+ * @param m The MSHRs.
+ * @param block The cache line accessed (address / CACHE_BLOCK_SIZE).
+ * @param t The cycle of the access.
+ * @param miss Non-zero if it missed in the cache.
+ * @param latency The cycles a fill takes.
+ * @param start Set to the cycle the access started: `t`, or later if all the MSHRs were busy.
+ * @param ready Set to the cycle the line arrives, `start` for hits.
+ * @return How the access was handled.
+ */
+enum mshr_result mshr_access(struct mshr *m, unsigned long block, unsigned long t, int miss, unsigned long latency,
+			     unsigned long *start, unsigned long *ready);
+
+/*
+ * Whether a fill of a line is in flight at `t`, so a miss on it would merge rather than
+ * reach the memory.
+ *
+ * @param m The MSHRs.
+ * @param block The cache line (address / CACHE_BLOCK_SIZE).
+ * @param t The cycle of the access.
+ */
+int mshr_pending(struct mshr *m, unsigned long block, unsigned long t);
+
+/*
+ * The first cycle from `t` an MSHR is free, when a miss at `t` would start.
+ *
+ * @param m The MSHRs.
+ * @param t The cycle of the miss.
+ */
+unsigned long mshr_wait(struct mshr *m, unsigned long t);
+
+/* Zero the miss counts and the occupancy, keeping the fills in flight */
+void mshr_stats_reset(struct mshr *m);
+
+/*
+ * Print the number of MSHRs, the primary and secondary misses, the average and peak occupancy,
+ * and the misses that found them all busy.
+ *
+ * @param m The MSHRs.
+ * @param cycles The cycles the timing model ran for.
+ */
+void mshr_print(struct mshr *m, unsigned long cycles);
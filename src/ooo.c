@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "ooo.h"
+#include "cache.h"
+
+// Cycles tracked ahead of the oldest one an instruction can still use, a power of two
+#define OOO_HORIZON (1UL << 18)
+// Entries in the table of recent stores, for store-to-load forwarding, a power of two
+#define OOO_STORES 4096
+
+enum dispatch_stall {
+	DISPATCH_ROB,      // The reorder buffer is full
+	DISPATCH_RENAME,   // No free rename register
+	DISPATCH_LQ,       // The load queue is full
+	DISPATCH_SQ,       // The store queue is full
+	DISPATCH_FRONTEND, // Refilling after a mispredict
+	DISPATCH_COUNT,
+};
+
+enum commit_stall {
+	COMMIT_MEMORY,     // The oldest instruction waits for a cache miss
+	COMMIT_EXECUTION,  // ... for the execution of it or of its producers
+	COMMIT_FRONTEND,   // ... for it to be fetched after a mispredict
+	COMMIT_WINDOW,     // ... for it to dispatch into a full structure
+	COMMIT_COUNT,
+};
+
+// Instructions issued in one cycle of the horizon
+struct issue_slot {
+	unsigned long cycle, count;
+};
+
+// The last store to a word
+struct store_entry {
+	unsigned long word;  // Word address + 1, 0 if empty
+	unsigned long ready; // Cycle its data can be forwarded
+};
+
+struct ooo {
+	struct ooo_config cfg;
+	unsigned long num_instrs, num_writers, num_loads, num_stores;
+	unsigned long reset_instrs, reset_cycles; // num_instrs and the cycles at the last statistics reset
+	// Commit cycles of the last rob_size instructions, rename_regs writers, lq_size loads and sq_size stores
+	unsigned long *rob, *rename, *lq, *sq;
+	unsigned long dispatch, dispatched;  // Cycle of the last dispatch, and instructions dispatched in it
+	unsigned long commit, committed;     // The same for commit
+	unsigned long fetch_ready;           // First cycle instructions after a mispredict dispatch
+	unsigned long reg_ready[32];         // Cycle each register's value is ready
+	int reg_miss[32];                    // Its value waited for a cache miss
+	struct issue_slot *issue;
+	struct store_entry stores[OOO_STORES];
+	unsigned int *outstanding;           // Misses outstanding in each cycle of the horizon
+	unsigned long swept;                 // Cycles before this one were counted in the MLP
+	unsigned long num_misses, miss_cycles, busy_cycles, miss_total, mispredicts;
+	unsigned long dispatch_stalls[DISPATCH_COUNT], commit_stalls[COMMIT_COUNT];
+	struct mshr *mshr;                   // The cache's MSHRs, NULL for unlimited misses
+	struct dram *dram;                   // Where misses go, NULL for the fixed miss latency
+};
+
+
+struct ooo *ooo_alloc(struct ooo_config *cfg) {
+	struct ooo *o;
+
+	if (cfg->rob_size == 0 || cfg->width == 0 || cfg->rename_regs == 0 || cfg->lq_size == 0 || cfg->sq_size == 0) {
+		fprintf(stderr, "Error: The out-of-order core needs a reorder buffer, width, rename registers and load/store queues.\n");
+		return NULL;
+	}
+	o = (struct ooo *)calloc(1, sizeof(struct ooo));
+	if (o == NULL) {
+		perror("Failed to allocate out-of-order core");
+		return NULL;
+	}
+	o->cfg = *cfg;
+	o->rob = (unsigned long *)calloc(cfg->rob_size, sizeof(unsigned long));
+	o->rename = (unsigned long *)calloc(cfg->rename_regs, sizeof(unsigned long));
+	o->lq = (unsigned long *)calloc(cfg->lq_size, sizeof(unsigned long));
+	o->sq = (unsigned long *)calloc(cfg->sq_size, sizeof(unsigned long));
+	o->issue = (struct issue_slot *)calloc(OOO_HORIZON, sizeof(struct issue_slot));
+	o->outstanding = (unsigned int *)calloc(OOO_HORIZON, sizeof(unsigned int));
+	if (!o->rob || !o->rename || !o->lq || !o->sq || !o->issue || !o->outstanding) {
+		perror("Failed to allocate out-of-order core");
+		ooo_free(o);
+		return NULL;
+	}
+	if (cfg->mshrs && !(o->mshr = mshr_alloc(cfg->mshrs))) {
+		ooo_free(o);
+		return NULL;
+	}
+
+	return o;
+}
+
+
+void ooo_free(struct ooo *o) {
+	if (o == NULL) return;
+	free(o->rob);
+	free(o->rename);
+	free(o->lq);
+	free(o->sq);
+	free(o->issue);
+	free(o->outstanding);
+	mshr_free(o->mshr);
+	dram_free(o->dram);
+	free(o);
+}
+
+
+void ooo_set_dram(struct ooo *o, struct dram *d) {
+	o->dram = d;
+}
+
+
+// The cycles a miss at cycle `t` takes
+static unsigned long miss_latency(struct ooo *o, unsigned long mem_addr, unsigned long t) {
+	return o->dram ? dram_access(o->dram, mem_addr, t) : o->cfg.miss_latency;
+}
+
+
+// Delay dispatch to `ready` if it is later, blaming `reason`
+static void dispatch_limit(unsigned long *d, enum dispatch_stall *reason, unsigned long ready, enum dispatch_stall r) {
+	if (ready <= *d) return;
+	*d = ready;
+	*reason = r;
+}
+
+
+// A structure of `size` entries, `n` of them used so far: the first cycle one is free
+static unsigned long entry_free(unsigned long *commits, unsigned long size, unsigned long n) {
+	return n >= size ? commits[n % size] + 1 : 0;
+}
+
+
+// Count the outstanding misses of the cycles no instruction can issue in anymore
+static void mlp_sweep(struct ooo *o, unsigned long until) {
+	for (; o->swept < until; o->swept++) {
+		unsigned int *n = &o->outstanding[o->swept & (OOO_HORIZON - 1)];
+
+		if (*n == 0) continue;
+		o->busy_cycles++;
+		o->miss_total += *n;
+		*n = 0;
+	}
+}
+
+
+// The first cycle from `t` with an issue slot left, taking it
+static unsigned long issue_slot(struct ooo *o, unsigned long t) {
+	for (;; t++) {
+		struct issue_slot *s = &o->issue[t & (OOO_HORIZON - 1)];
+
+		if (s->cycle != t) {
+			s->cycle = t;
+			s->count = 0;
+		}
+		if (s->count < o->cfg.width) {
+			s->count++;
+			return t;
+		}
+	}
+}
+
+
+void ooo_retire(struct ooo *o, struct instruction *i, int mispredicted, int mem_hit, unsigned long mem_addr) {
+	enum instr_class class = instr_class(i->inst_no);
+	enum dispatch_stall reason = DISPATCH_COUNT;
+	unsigned int rd, rs[2];
+	unsigned long slot, d, ready, t, lat, done, start, c;
+	int miss = class == CLASS_LOAD && mem_hit == 0, waits_miss = 0, forwarded = 0;
+	struct store_entry *st;
+
+	if (o == NULL) return;
+	instr_regs(i, &rd, &rs[0], &rs[1]);
+	st = &o->stores[(mem_addr >> 3) & (OOO_STORES - 1)];
+
+	// Dispatch in order, into every structure the instruction needs
+	slot = o->num_instrs > 0 && o->dispatched >= o->cfg.width ? o->dispatch + 1 : o->dispatch;
+	d = slot;
+	dispatch_limit(&d, &reason, entry_free(o->rob, o->cfg.rob_size, o->num_instrs), DISPATCH_ROB);
+	if (rd != 0) dispatch_limit(&d, &reason, entry_free(o->rename, o->cfg.rename_regs, o->num_writers), DISPATCH_RENAME);
+	if (class == CLASS_LOAD) dispatch_limit(&d, &reason, entry_free(o->lq, o->cfg.lq_size, o->num_loads), DISPATCH_LQ);
+	if (class == CLASS_STORE) dispatch_limit(&d, &reason, entry_free(o->sq, o->cfg.sq_size, o->num_stores), DISPATCH_SQ);
+	dispatch_limit(&d, &reason, o->fetch_ready, DISPATCH_FRONTEND);
+	if (reason != DISPATCH_COUNT) o->dispatch_stalls[reason] += d - slot;
+	if (d != o->dispatch) o->dispatched = 0;
+	o->dispatch = d;
+	o->dispatched++;
+	// Later instructions dispatch, so issue, no earlier than this one
+	mlp_sweep(o, d);
+
+	// Issue out of order once the operands are ready, the value of a load from an earlier store
+	ready = d + 1;
+	for (int r = 0; r < 2; r++) {
+		if (rs[r] != 0 && o->reg_ready[rs[r]] > ready) {
+			ready = o->reg_ready[rs[r]];
+			waits_miss = o->reg_miss[rs[r]];
+		}
+	}
+	if (class == CLASS_LOAD && st->word == (mem_addr >> 3) + 1 && st->ready > ready) {
+		ready = st->ready;
+		waits_miss = 0;
+		miss = 0;
+		forwarded = 1;
+	}
+	t = issue_slot(o, ready);
+	switch (class) {
+	case CLASS_LOAD:
+		lat = miss && !o->mshr ? miss_latency(o, mem_addr, t) : o->cfg.hit_latency;
+		break;
+	case CLASS_BRANCH:
+	case CLASS_JUMP:
+		lat = o->cfg.branch_latency;
+		break;
+	default:
+		lat = o->cfg.alu_latency;
+		break;
+	}
+	done = t + lat;
+	start = t;
+	if (o->mshr && (class == CLASS_STORE || (class == CLASS_LOAD && !forwarded))) {
+		unsigned long fill, latency = 0;
+		enum mshr_result r;
+
+		// Only a primary miss goes to the memory, a secondary one waits for its fill
+		if (mem_hit == 0 && !mshr_pending(o->mshr, mem_addr / CACHE_BLOCK_SIZE, t)) {
+			latency = miss_latency(o, mem_addr, mshr_wait(o->mshr, t));
+		}
+		// Stores take an MSHR too, but wait for it and for their line in the store queue
+		r = mshr_access(o->mshr, mem_addr / CACHE_BLOCK_SIZE, t, mem_hit == 0, latency, &start, &fill);
+
+		if (class == CLASS_LOAD && r == MSHR_MERGED) {
+			if (fill > done) done = fill;
+			waits_miss = 1;
+		}
+		if (class == CLASS_LOAD && r == MSHR_ALLOCATED) done = fill;
+	} else if (class == CLASS_STORE && mem_hit == 0 && o->dram) {
+		// The store queue hides the miss, but the line still comes from the DRAM
+		dram_access(o->dram, mem_addr, t);
+	}
+	if (miss) {
+		o->num_misses++;
+		o->miss_cycles += done - start;
+		for (unsigned long x = start; x < done && x < o->swept + OOO_HORIZON; x++) {
+			o->outstanding[x & (OOO_HORIZON - 1)]++;
+		}
+	}
+	if (rd != 0) {
+		o->reg_ready[rd] = done;
+		o->reg_miss[rd] = miss || waits_miss;
+	}
+	if (class == CLASS_STORE) *st = (struct store_entry){ .word = (mem_addr >> 3) + 1, .ready = done };
+	if (mispredicted) {
+		o->mispredicts++;
+		o->fetch_ready = done + o->cfg.redirect_penalty;
+	}
+
+	// Commit in order, once done
+	slot = o->num_instrs > 0 && o->committed >= o->cfg.width ? o->commit + 1 : o->commit;
+	c = done > slot ? done : slot;
+	if (c > slot) {
+		enum commit_stall why;
+
+		if (miss || waits_miss) {
+			why = COMMIT_MEMORY;
+		} else if (ready > d + 1 || reason == DISPATCH_COUNT) {
+			why = COMMIT_EXECUTION;
+		} else {
+			why = reason == DISPATCH_FRONTEND ? COMMIT_FRONTEND : COMMIT_WINDOW;
+		}
+		o->commit_stalls[why] += c - slot;
+	}
+	if (c != o->commit) o->committed = 0;
+	o->commit = c;
+	o->committed++;
+
+	// The instruction frees its entries as it commits
+	o->rob[o->num_instrs++ % o->cfg.rob_size] = c;
+	if (rd != 0) o->rename[o->num_writers++ % o->cfg.rename_regs] = c;
+	if (class == CLASS_LOAD) o->lq[o->num_loads++ % o->cfg.lq_size] = c;
+	if (class == CLASS_STORE) o->sq[o->num_stores++ % o->cfg.sq_size] = c;
+}
+
+
+void ooo_stats_reset(struct ooo *o) {
+	if (o == NULL) return;
+	o->reset_instrs = o->num_instrs;
+	o->reset_cycles = o->num_instrs == 0 ? 0 : o->commit + 1;
+	o->num_misses = o->miss_cycles = o->busy_cycles = o->miss_total = o->mispredicts = 0;
+	for (int r = 0; r < DISPATCH_COUNT; r++) {
+		o->dispatch_stalls[r] = 0;
+	}
+	for (int s = 0; s < COMMIT_COUNT; s++) {
+		o->commit_stalls[s] = 0;
+	}
+	mshr_stats_reset(o->mshr);
+	dram_stats_reset(o->dram);
+}
+
+
+void ooo_print(struct ooo *o) {
+	static const char *dispatch_names[DISPATCH_COUNT] = { "ROB", "rename registers", "load queue", "store queue", "front end" };
+	static const char *commit_names[COMMIT_COUNT] = { "memory", "execution", "front end", "window" };
+	unsigned long cycles, instrs, stalls = 0, worst = 0;
+	const char *bottleneck = "width";
+
+	if (o == NULL) return;
+	instrs = o->num_instrs - o->reset_instrs;
+	cycles = instrs == 0 ? 0 : o->commit + 1 - o->reset_cycles;
+	mlp_sweep(o, o->swept + OOO_HORIZON);
+	for (int s = 0; s < COMMIT_COUNT; s++) {
+		stalls += o->commit_stalls[s];
+	}
+	// Whatever delayed the oldest instruction the most, the width if it rarely waited
+	worst = cycles - stalls;
+	for (int s = 0; s < COMMIT_COUNT; s++) {
+		if (o->commit_stalls[s] <= worst) continue;
+		worst = o->commit_stalls[s];
+		bottleneck = commit_names[s];
+		if (s == COMMIT_WINDOW) {
+			unsigned long full = 0;
+
+			for (int r = 0; r < DISPATCH_FRONTEND; r++) {
+				if (o->dispatch_stalls[r] <= full) continue;
+				full = o->dispatch_stalls[r];
+				bottleneck = dispatch_names[r];
+			}
+		}
+	}
+
+	printf("Out-of-Order Core: ROB: %lu, Width: %lu, Rename Registers: %lu, Load Queue: %lu, Store Queue: %lu\n",
+		o->cfg.rob_size, o->cfg.width, o->cfg.rename_regs, o->cfg.lq_size, o->cfg.sq_size);
+	printf("Latencies: ALU: %lu, Branch: %lu, Load: %lu hit, ", o->cfg.alu_latency, o->cfg.branch_latency, o->cfg.hit_latency);
+	// Misses take what DRAM says, printed below, rather than the fixed latency
+	if (o->dram) printf("DRAM miss");
+	else printf("%lu miss", o->cfg.miss_latency);
+	printf(", Mispredict Penalty: %lu\n", o->cfg.redirect_penalty);
+	printf("Cycles: %lu, Instructions: %lu, IPC: %.3f, CPI: %.3f\n", cycles, instrs,
+		cycles == 0 ? 0.0 : (double)instrs / (double)cycles,
+		instrs == 0 ? 0.0 : (double)cycles / (double)instrs);
+	printf("Dispatch Stall Cycles: ROB Full: %lu, Rename Full: %lu, Load Queue Full: %lu, Store Queue Full: %lu, Mispredicts (%lu): %lu\n",
+		o->dispatch_stalls[DISPATCH_ROB], o->dispatch_stalls[DISPATCH_RENAME], o->dispatch_stalls[DISPATCH_LQ],
+		o->dispatch_stalls[DISPATCH_SQ], o->mispredicts, o->dispatch_stalls[DISPATCH_FRONTEND]);
+	printf("Commit Stall Cycles: %lu, Memory: %lu, Execution: %lu, Front End: %lu, Window Full: %lu\n", stalls,
+		o->commit_stalls[COMMIT_MEMORY], o->commit_stalls[COMMIT_EXECUTION], o->commit_stalls[COMMIT_FRONTEND],
+		o->commit_stalls[COMMIT_WINDOW]);
+	printf("Load Misses: %lu, Miss Latency: %lu cycles, MLP: %.2f, Exposed: %lu cycles (%.2f%% hidden)\n",
+		o->num_misses, o->miss_cycles, o->busy_cycles == 0 ? 0.0 : (double)o->miss_total / (double)o->busy_cycles,
+		o->commit_stalls[COMMIT_MEMORY], o->miss_cycles == 0 || o->commit_stalls[COMMIT_MEMORY] >= o->miss_cycles ? 0.0 :
+		(1.0 - (double)o->commit_stalls[COMMIT_MEMORY] / (double)o->miss_cycles) * 100.0);
+	mshr_print(o->mshr, cycles);
+	dram_print(o->dram);
+	printf("Bottleneck: %s\n", bottleneck);
+}
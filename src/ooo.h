@@ -0,0 +1,73 @@
+#pragma once
+
+#include <instructions.h>
+#include <mshr.h>
+#include <dram.h>
+
+/*
+ * Timing of an out-of-order core, fed the instructions in the order they commit. Not cycle
+ * exact: each instruction is given the cycle it dispatches, issues, completes and commits,
+ * from the instructions before it.
+ *
+ * - Dispatch is in order, `width` instructions per cycle, once the instruction has a slot in
+ *   the reorder buffer, a rename register if it writes one, and a load or store queue entry
+ *   if it accesses memory: these are freed when the instruction holding them commits. After a
+ *   mispredicted branch, dispatch resumes `redirect_penalty` cycles after the branch executes.
+ * - Issue is out of order, at most `width` instructions per cycle, once the source operands
+ *   are ready. Loads wait for an earlier store to the same word, and otherwise take the
+ *   cache's hit or miss latency. Any number of misses can be outstanding, unless the cache
+ *   has MSHRs: then a miss waits for a free one, and a load to a line still being filled
+ *   waits for that fill. With a DRAM, a miss takes as long as the DRAM takes to return its
+ *   line, and store misses also read their line from it.
+ * - Commit is in order, `width` instructions per cycle, once the instruction completed.
+ *
+ * The report breaks down why dispatch stalled (which structure was full) and why commit
+ * stalled (what the oldest instruction was waiting for), and measures memory-level
+ * parallelism: how many misses are outstanding, on average, while any is, and how many
+ * cycles the core stalled with a miss at the head of the reorder buffer.
+ */
+
+struct ooo_config {
+	unsigned long rob_size;         // Reorder buffer entries
+	unsigned long width;            // Instructions dispatched, issued and committed per cycle
+	unsigned long rename_regs;      // Registers for results in flight, beyond the 32 architectural ones
+	unsigned long lq_size, sq_size; // Load and store queue entries
+	unsigned long alu_latency;      // Cycles to execute an ALU operation
+	unsigned long branch_latency;   // Cycles to execute a branch or jump
+	unsigned long hit_latency;      // Cycles for a load that hits in the cache
+	unsigned long miss_latency;     // Cycles for a load that misses
+	unsigned long redirect_penalty; // Cycles to refill the front end after a mispredict
+	unsigned long mshrs;            // MSHRs of the cache, 0 for unlimited misses in flight
+};
+
+/* Define this as you'd like in your .c file. */
+struct ooo;
+
+struct ooo *ooo_alloc(struct ooo_config *cfg);
+void ooo_free(struct ooo *o);
+
+/* Serve the misses from `d` instead of with a fixed latency. The core frees it. */
+void ooo_set_dram(struct ooo *o, struct dram *d);
+
+/*
+ * Account for one committed instruction.
+ *
+ * @param o The core.
+ * @param i The instruction.
+ * @param mispredicted Non-zero if it is a branch or jump the front end mispredicted.
+ * @param mem_hit For loads and stores, 1 if the access hit in the cache and 0 if it missed.
+ * @param mem_addr For loads and stores, the address accessed.
+ */
+void ooo_retire(struct ooo *o, struct instruction *i, int mispredicted, int mem_hit, unsigned long mem_addr);
+
+/*
+ * Count cycles and instructions from the last committed instruction on, and zero the stall
+ * breakdowns, the misses, the MSHRs' and the DRAM's statistics. The core's state is kept.
+ */
+void ooo_stats_reset(struct ooo *o);
+
+/*
+ * Print the configuration, the cycles, IPC, the stall breakdowns, the memory-level parallelism,
+ * the MSHRs and the DRAM
+ */
+void ooo_print(struct ooo *o);
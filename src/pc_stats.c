@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pc_stats.h"
+
+// Initial number of hash table slots, a power of two
+#define PC_STATS_INIT_SIZE 1024
+
+struct pc_stats {
+	struct pc_stat *slots; // Open addressing with linear probing, free slots have no accesses
+	unsigned long size;    // Number of slots, a power of two
+	unsigned long count;   // Slots in use
+};
+
+
+static inline unsigned long pc_hash(unsigned long pc) {
+	// Instructions are 4-byte aligned, and Fibonacci hashing spreads nearby ones
+	return (pc >> 2) * 0x9e3779b97f4a7c15UL;
+}
+
+
+struct pc_stats *pc_stats_alloc(void) {
+	struct pc_stats *ps = (struct pc_stats *)calloc(1, sizeof(struct pc_stats));
+
+	if (ps == NULL) {
+		perror("Failed to allocate pc statistics");
+		return NULL;
+	}
+	ps->size = PC_STATS_INIT_SIZE;
+	ps->slots = (struct pc_stat *)calloc(ps->size, sizeof(struct pc_stat));
+	if (ps->slots == NULL) {
+		perror("Failed to allocate pc statistics table");
+		free(ps);
+		return NULL;
+	}
+
+	return ps;
+}
+
+
+void pc_stats_free(struct pc_stats *ps) {
+	if (ps == NULL) return;
+	free(ps->slots);
+	free(ps);
+}
+
+
+void pc_stats_reset(struct pc_stats *ps) {
+	if (ps == NULL) return;
+	memset(ps->slots, 0, ps->size * sizeof(struct pc_stat));
+	ps->count = 0;
+}
+
+
+// Find the slot of `pc`, or the free slot where it goes
+static struct pc_stat *pc_stats_slot(struct pc_stat *slots, unsigned long size, unsigned long pc) {
+	unsigned long i = pc_hash(pc) & (size - 1);
+
+	while (slots[i].accesses != 0 && slots[i].pc != pc) {
+		i = (i + 1) & (size - 1);
+	}
+	return &slots[i];
+}
+
+
+// Double the table when it is half full
+static int pc_stats_grow(struct pc_stats *ps) {
+	unsigned long size = ps->size * 2;
+	struct pc_stat *slots = (struct pc_stat *)calloc(size, sizeof(struct pc_stat));
+
+	if (slots == NULL) {
+		perror("Failed to grow pc statistics table");
+		return -1;
+	}
+	for (unsigned long i = 0; i < ps->size; i++) {
+		if (ps->slots[i].accesses != 0) *pc_stats_slot(slots, size, ps->slots[i].pc) = ps->slots[i];
+	}
+	free(ps->slots);
+	ps->slots = slots;
+	ps->size = size;
+
+	return 0;
+}
+
+
+void pc_stats_record(struct pc_stats *ps, unsigned long pc, int miss) {
+	struct pc_stat *s;
+
+	if (ps == NULL) return;
+	s = pc_stats_slot(ps->slots, ps->size, pc);
+	if (s->accesses == 0) {
+		// A new instruction, make room for it first if needed
+		if (ps->count + 1 > ps->size / 2) {
+			if (pc_stats_grow(ps) != 0) return;
+			s = pc_stats_slot(ps->slots, ps->size, pc);
+		}
+		s->pc = pc;
+		ps->count++;
+	}
+	s->accesses++;
+	if (miss) s->misses++;
+}
+
+
+struct pc_stat pc_stats_get(struct pc_stats *ps, unsigned long pc) {
+	struct pc_stat s = { .pc = pc }, *slot;
+
+	if (ps == NULL) return s;
+	slot = pc_stats_slot(ps->slots, ps->size, pc);
+	if (slot->accesses != 0) s = *slot;
+	return s;
+}
+
+
+// Most misses first, then the highest miss rate, then the lowest pc
+static int pc_stat_cmp(const void *a, const void *b) {
+	const struct pc_stat *x = (const struct pc_stat *)a, *y = (const struct pc_stat *)b;
+
+	if (x->misses != y->misses) return x->misses > y->misses ? -1 : 1;
+	// x->misses / x->accesses vs y->misses / y->accesses, without dividing
+	if (x->misses * y->accesses != y->misses * x->accesses) {
+		return x->misses * y->accesses > y->misses * x->accesses ? -1 : 1;
+	}
+	return x->pc < y->pc ? -1 : (x->pc > y->pc);
+}
+
+
+unsigned long pc_stats_top(struct pc_stats *ps, struct pc_stat *out, unsigned long max) {
+	struct pc_stat *all;
+	unsigned long n = 0;
+
+	if (ps == NULL || max == 0) return 0;
+	all = (struct pc_stat *)malloc(ps->count * sizeof(struct pc_stat) + 1);
+	if (all == NULL) {
+		perror("Failed to sort pc statistics");
+		return 0;
+	}
+	for (unsigned long i = 0; i < ps->size; i++) {
+		if (ps->slots[i].accesses != 0) all[n++] = ps->slots[i];
+	}
+	qsort(all, n, sizeof(struct pc_stat), pc_stat_cmp);
+	if (n > max) n = max;
+	for (unsigned long i = 0; i < n; i++) {
+		out[i] = all[i];
+	}
+	free(all);
+
+	return n;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+/*
+ * Per-instruction event counters: how many times each pc performed an event (e.g. a cache
+ * access) and how many of those missed. Used to attribute cache misses to the loads and
+ * stores that cause them.
+ */
+
+struct pc_stat {
+	unsigned long pc;
+	unsigned long accesses, misses;
+};
+
+/* Define this as you'd like in your .c file. */
+struct pc_stats;
+
+struct pc_stats *pc_stats_alloc(void);
+void pc_stats_free(struct pc_stats *ps);
+
+/* Forget all the counters. */
+void pc_stats_reset(struct pc_stats *ps);
+
+/*
+ * Count one event of the instruction at `pc`.
+ *
+ * @param ps The counters.
+ * @param pc The address of the instruction.
+ * @param miss Non-zero if the event was a miss.
+ */
+void pc_stats_record(struct pc_stats *ps, unsigned long pc, int miss);
+
+/*
+ * The counters of one instruction.
+ *
+ * @param ps The counters.
+ * @param pc The address of the instruction.
+ * @return Its counters, all 0 if it has none.
+ */
+struct pc_stat pc_stats_get(struct pc_stats *ps, unsigned long pc);
+
+/*
+ * The instructions with the most misses, ties broken by miss rate.
+ *
+ * @param ps The counters.
+ * @param out Filled with up to `max` instructions, most misses first.
+ * @param max The number of instructions wanted.
+ * @return The number of instructions written to `out`.
+ */
+unsigned long pc_stats_top(struct pc_stats *ps, struct pc_stat *out, unsigned long max);
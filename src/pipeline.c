@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "pipeline.h"
+#include "cache.h"
+
+// The first instruction enters EX after IF and ID, in cycle 2 counting from 0
+#define PIPELINE_FILL 2
+
+enum stall_reason {
+	STALL_DATA,     // Waiting for an ALU result
+	STALL_LOAD_USE, // Waiting for a load
+	STALL_MEMORY,   // Waiting for the previous instruction to leave MEM
+	STALL_CONTROL,  // Fetch redirected by a taken branch or jump
+	STALL_COUNT,
+};
+
+struct pipeline {
+	struct pipeline_config cfg;
+	unsigned long issue;            // Cycle the last instruction entered EX
+	unsigned long issued;           // Instructions that entered EX in that cycle
+	unsigned long mem_free;         // First cycle the next instruction may enter EX, for MEM
+	unsigned long cycles;           // Cycles until the last instruction left WB
+	unsigned long fetch_ready;      // First cycle the next instruction may enter EX, for fetch
+	unsigned long reg_ready[32];    // First cycle an instruction may enter EX and use a register
+	int reg_load[32];               // The register's last writer was a load
+	unsigned long num_instrs;
+	unsigned long reset_instrs, reset_cycles; // num_instrs and cycles at the last statistics reset
+	unsigned long stalls[STALL_COUNT];
+	struct mshr *mshr;              // The non-blocking cache's MSHRs, NULL if it blocks
+	struct dram *dram;              // Where misses go, NULL for the fixed miss latency
+};
+
+
+struct pipeline *pipeline_alloc(struct pipeline_config *cfg) {
+	struct pipeline *pl;
+
+	if (cfg->width == 0) {
+		fprintf(stderr, "Error: The pipeline must be at least one instruction wide.\n");
+		return NULL;
+	}
+	pl = (struct pipeline *)calloc(1, sizeof(struct pipeline));
+	if (pl == NULL) {
+		perror("Failed to allocate pipeline");
+		return NULL;
+	}
+	pl->cfg = *cfg;
+	if (pl->cfg.hit_latency == 0) pl->cfg.hit_latency = 1;
+	pl->issue = PIPELINE_FILL;
+	pl->mem_free = pl->fetch_ready = PIPELINE_FILL;
+	if (cfg->mshrs && !(pl->mshr = mshr_alloc(cfg->mshrs))) {
+		free(pl);
+		return NULL;
+	}
+
+	return pl;
+}
+
+
+void pipeline_free(struct pipeline *pl) {
+	if (pl == NULL) return;
+	mshr_free(pl->mshr);
+	dram_free(pl->dram);
+	free(pl);
+}
+
+
+void pipeline_set_dram(struct pipeline *pl, struct dram *d) {
+	pl->dram = d;
+}
+
+
+// The cycles a miss at cycle `t` takes
+static unsigned long miss_latency(struct pipeline *pl, unsigned long mem_addr, unsigned long t) {
+	return pl->dram ? dram_access(pl->dram, mem_addr, t) : pl->cfg.miss_latency;
+}
+
+
+void pipeline_retire(struct pipeline *pl, struct instruction *i, int taken, int mem_hit, unsigned long mem_addr) {
+	enum instr_class class = instr_class(i->inst_no);
+	unsigned int rd, rs[2];
+	unsigned long slot, t, mem_latency = 1, data;
+	enum stall_reason reason = STALL_DATA;
+
+	if (pl == NULL) return;
+	instr_regs(i, &rd, &rs[0], &rs[1]);
+
+	// The in-order slot: alongside the previous instruction if there's room, or right after
+	slot = pl->num_instrs > 0 && pl->issued >= pl->cfg.width ? pl->issue + 1 : pl->issue;
+	t = slot;
+	for (int r = 0; r < 2; r++) {
+		if (rs[r] != 0 && pl->reg_ready[rs[r]] > t) {
+			t = pl->reg_ready[rs[r]];
+			reason = pl->reg_load[rs[r]] ? STALL_LOAD_USE : STALL_DATA;
+		}
+	}
+	if (pl->mem_free > t) {
+		t = pl->mem_free;
+		reason = STALL_MEMORY;
+	}
+	if (pl->fetch_ready > t) {
+		t = pl->fetch_ready;
+		reason = STALL_CONTROL;
+	}
+	pl->stalls[reason] += t - slot;
+
+	if (t != pl->issue) pl->issued = 0;
+	pl->issue = t;
+	pl->issued++;
+	pl->num_instrs++;
+
+	if ((class == CLASS_LOAD || class == CLASS_STORE) && pl->mshr == NULL) {
+		mem_latency = mem_hit ? pl->cfg.hit_latency : miss_latency(pl, mem_addr, t + 1);
+	}
+	// The value of an instruction is ready after EX, or after MEM for loads
+	data = t + (class == CLASS_LOAD ? mem_latency : 0) + 1;
+	if ((class == CLASS_LOAD || class == CLASS_STORE) && pl->mshr) {
+		unsigned long start, ready, fill = 0;
+
+		// Only a primary miss goes to the memory, a secondary one waits for its fill
+		if (!mem_hit && !mshr_pending(pl->mshr, mem_addr / CACHE_BLOCK_SIZE, t + 1)) {
+			fill = miss_latency(pl, mem_addr, mshr_wait(pl->mshr, t + 1));
+		}
+
+		// Non-blocking: in MEM until the access has an MSHR and the tags are checked, and a
+		// load's value is ready once its line arrived
+		mshr_access(pl->mshr, mem_addr / CACHE_BLOCK_SIZE, t + 1, !mem_hit, fill, &start, &ready);
+		mem_latency = start - (t + 1) + pl->cfg.hit_latency;
+		data = t + mem_latency + 1;
+		if (class == CLASS_LOAD && ready > data) data = ready;
+	}
+	// Instructions behind this one can only enter EX as it moves on from MEM: a multi-cycle
+	// access blocks them, a single-cycle one overlaps with the next instructions' EX
+	if (mem_latency > 1 && t + mem_latency > pl->mem_free) pl->mem_free = t + mem_latency;
+	// MEM from t + 1 to t + mem_latency, then WB (once the value is ready), and cycles count from 0
+	if (t + mem_latency + 2 > pl->cycles) pl->cycles = t + mem_latency + 2;
+	if (data + 1 > pl->cycles) pl->cycles = data + 1;
+	if (taken) pl->fetch_ready = t + 1 + pl->cfg.branch_penalty;
+	if (rd != 0) {
+		// Forwarded as soon as it is ready, or read after WB
+		pl->reg_ready[rd] = data + (pl->cfg.forwarding ? 0 : 2);
+		pl->reg_load[rd] = class == CLASS_LOAD;
+	}
+}
+
+
+void pipeline_stats_reset(struct pipeline *pl) {
+	if (pl == NULL) return;
+	pl->reset_instrs = pl->num_instrs;
+	pl->reset_cycles = pl->cycles;
+	for (int r = 0; r < STALL_COUNT; r++) {
+		pl->stalls[r] = 0;
+	}
+	mshr_stats_reset(pl->mshr);
+	dram_stats_reset(pl->dram);
+}
+
+
+void pipeline_print(struct pipeline *pl) {
+	unsigned long cycles, instrs, total = 0;
+
+	if (pl == NULL) return;
+	cycles = pl->cycles - pl->reset_cycles;
+	instrs = pl->num_instrs - pl->reset_instrs;
+	for (int r = 0; r < STALL_COUNT; r++) {
+		total += pl->stalls[r];
+	}
+
+	printf("Pipeline: 5-stage in-order, Width: %lu, Forwarding: %s, Branch Penalty: %lu, Memory Latency: %lu hit, ",
+		pl->cfg.width, pl->cfg.forwarding ? "on" : "off", pl->cfg.branch_penalty, pl->cfg.hit_latency);
+	// Misses take what DRAM says, printed below, rather than the fixed latency
+	if (pl->dram) printf("DRAM miss\n");
+	else printf("%lu miss\n", pl->cfg.miss_latency);
+	printf("Cycles: %lu, Instructions: %lu, CPI: %.3f, IPC: %.3f\n", cycles, instrs,
+		instrs == 0 ? 0.0 : (double)cycles / (double)instrs,
+		cycles == 0 ? 0.0 : (double)instrs / (double)cycles);
+	printf("Stall Cycles: %lu, Data Hazards: %lu, Load-Use: %lu, Memory: %lu, Control: %lu\n", total,
+		pl->stalls[STALL_DATA], pl->stalls[STALL_LOAD_USE], pl->stalls[STALL_MEMORY], pl->stalls[STALL_CONTROL]);
+	mshr_print(pl->mshr, cycles);
+	dram_print(pl->dram);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <instructions.h>
+#include <mshr.h>
+#include <dram.h>
+
+/*
+ * Timing of a classic 5-stage in-order pipeline (IF, ID, EX, MEM, WB), fed the instructions
+ * in the order they execute. Each instruction enters EX at the first cycle where:
+ *
+ * - it stays in program order, with at most `width` instructions entering EX per cycle;
+ * - its source registers are ready: with forwarding, an ALU result can be used in the next
+ *   cycle and a load's once it leaves MEM (one stall cycle after a load hit: the load-use
+ *   hazard); without, results are read from the register file after WB;
+ * - the previous instruction has left MEM, which takes the cache's hit or miss latency for
+ *   loads and stores: the cache blocks the pipeline on a miss. With MSHRs, the cache is
+ *   non-blocking instead: a load or store spends the hit latency in MEM (waiting there for
+ *   an MSHR if they are all busy), and the instructions using a load's value wait for its
+ *   line to arrive. With a DRAM, a miss takes as long as the DRAM takes to return its line;
+ * - a taken branch or jump, resolved in EX while the pipeline fetched the next
+ *   instructions (predict not-taken), has redirected fetch: `branch_penalty` cycles.
+ *
+ * The cycles an instruction waits beyond its in-order slot are charged to the constraint
+ * that held it the longest.
+ */
+
+struct pipeline_config {
+	unsigned long width;            // Instructions entering EX per cycle
+	unsigned long branch_penalty;   // Cycles lost to a taken branch or jump
+	unsigned long hit_latency;      // Cycles in MEM for a cache hit
+	unsigned long miss_latency;     // Cycles in MEM for a cache miss
+	int forwarding;                 // Bypass results from EX/MEM instead of waiting for WB
+	unsigned long mshrs;            // MSHRs of a non-blocking cache, 0 for a blocking one
+};
+
+/* Define this as you'd like in your .c file. */
+struct pipeline;
+
+struct pipeline *pipeline_alloc(struct pipeline_config *cfg);
+void pipeline_free(struct pipeline *pl);
+
+/* Serve the misses from `d` instead of with a fixed latency. The pipeline frees it. */
+void pipeline_set_dram(struct pipeline *pl, struct dram *d);
+
+/*
+ * Account for one executed instruction.
+ *
+ * @param pl The pipeline.
+ * @param i The instruction.
+ * @param taken Non-zero if it changed the flow of control (a taken branch, or a jump).
+ * @param mem_hit For loads and stores, 1 if the access hit in the cache and 0 if it
+ *        missed. Ignored for other instructions.
+ * @param mem_addr For loads and stores, the address accessed.
+ */
+void pipeline_retire(struct pipeline *pl, struct instruction *i, int taken, int mem_hit, unsigned long mem_addr);
+
+/*
+ * Count cycles and instructions from the last instruction to leave WB on, and zero the stall
+ * cycles, the MSHRs' and the DRAM's statistics. The instructions in flight are kept.
+ */
+void pipeline_stats_reset(struct pipeline *pl);
+
+/* Print the configuration, the cycles, CPI, the breakdown of the stall cycles, the MSHRs and the DRAM */
+void pipeline_print(struct pipeline *pl);
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+#include "prefetch.h"
+
+// Number of entries in the stride prefetcher's reference prediction table
+#define RPT_ENTRIES 64
+// Number of sequential streams the stream prefetcher tracks at once
+#define STREAM_ENTRIES 16
+// How many lines away from the end of a stream an access may be and still extend it
+#define STREAM_WINDOW 16
+// How many in-order accesses a stream needs before it starts prefetching
+#define STREAM_CONFIRM 2
+
+// Chen & Baer reference prediction table states
+enum rpt_state {
+	RPT_INITIAL,   // First time we see this pc, or the stride just changed
+	RPT_TRANSIENT, // The stride was seen once, wait for it to repeat
+	RPT_STEADY,    // The stride repeated, prefetch along it
+	RPT_NOPRED,    // The stride keeps changing, stay quiet
+};
+
+struct rpt_entry {
+	unsigned long pc;        // Address of the load/store owning this entry
+	unsigned long last_addr; // The last address that load/store accessed
+	long stride;             // Distance between its last two accesses
+	enum rpt_state state;
+	int valid;
+};
+
+struct stream_entry {
+	unsigned long last_block; // Most recent line number in the stream
+	int direction;            // +1 ascending, -1 descending, 0 not yet known
+	int confidence;           // Number of accesses that followed the direction
+	unsigned long lru;        // Last time this stream was touched
+	int valid;
+};
+
+struct prefetcher {
+	enum prefetch_type type;
+	unsigned long degree;
+	unsigned long distance;
+	unsigned long now; // Number of accesses observed, used for the stream LRU
+
+	struct rpt_entry rpt[RPT_ENTRIES];
+	struct stream_entry streams[STREAM_ENTRIES];
+};
+
+
+struct prefetcher *prefetcher_alloc(enum prefetch_type type, unsigned long degree, unsigned long distance) {
+	if (type == PREFETCH_NONE) {
+		return NULL;
+	}
+	if (degree == 0 || distance == 0 || degree > PREFETCH_DEGREE_MAX) {
+		fprintf(stderr, "Error: Prefetch degree must be between 1 and %d, and distance at least 1.\n", PREFETCH_DEGREE_MAX);
+		return NULL;
+	}
+
+	// calloc leaves every table entry invalid
+	struct prefetcher *pf = (struct prefetcher *)calloc(1, sizeof(struct prefetcher));
+	if (pf == NULL) {
+		perror("Failed to allocate prefetcher");
+		return NULL;
+	}
+	pf->type = type;
+	pf->degree = degree;
+	pf->distance = distance;
+
+	return pf;
+}
+
+
+void prefetcher_free(struct prefetcher *pf) {
+	free(pf);
+}
+
+
+// Always fetch `degree` lines starting `distance` lines after the accessed one.
+static int nextline_observe(struct prefetcher *pf, unsigned long mem_addr, unsigned long *out, int max) {
+	unsigned long block = mem_addr / CACHE_BLOCK_SIZE;
+	int n = 0;
+
+	for (unsigned long i = 0; i < pf->degree && n < max; i++) {
+		out[n++] = (block + pf->distance + i) * CACHE_BLOCK_SIZE;
+	}
+	return n;
+}
+
+
+// Track the stride of every load/store, and prefetch along strides that repeat.
+static int stride_observe(struct prefetcher *pf, unsigned long pc, unsigned long mem_addr, unsigned long *out, int max) {
+	struct rpt_entry *e = &pf->rpt[(pc / 4) % RPT_ENTRIES];
+	int n = 0;
+
+	if (!e->valid || e->pc != pc) {
+		// New (or conflicting) load/store: take over the entry
+		*e = (struct rpt_entry){ .pc = pc, .last_addr = mem_addr, .stride = 0, .state = RPT_INITIAL, .valid = 1 };
+		return 0;
+	}
+
+	long stride = (long)(mem_addr - e->last_addr);
+	int correct = (stride == e->stride);
+
+	switch (e->state) {
+	case RPT_INITIAL:
+		e->state = correct ? RPT_STEADY : RPT_TRANSIENT;
+		break;
+	case RPT_TRANSIENT:
+		e->state = correct ? RPT_STEADY : RPT_NOPRED;
+		break;
+	case RPT_STEADY:
+		e->state = correct ? RPT_STEADY : RPT_INITIAL;
+		break;
+	case RPT_NOPRED:
+		e->state = correct ? RPT_TRANSIENT : RPT_NOPRED;
+		break;
+	}
+	// The stride is only replaced when the prediction was not steady
+	if (!correct && e->state != RPT_INITIAL) {
+		e->stride = stride;
+	}
+	e->last_addr = mem_addr;
+
+	if (e->state == RPT_STEADY && e->stride != 0) {
+		for (unsigned long i = 0; i < pf->degree && n < max; i++) {
+			out[n++] = mem_addr + e->stride * (long)(pf->distance + i);
+		}
+	}
+	return n;
+}
+
+
+// Find sequential (ascending or descending) line streams, and run ahead of confirmed ones.
+static int stream_observe(struct prefetcher *pf, unsigned long mem_addr, int hit, unsigned long *out, int max) {
+	unsigned long block = mem_addr / CACHE_BLOCK_SIZE;
+	struct stream_entry *s = NULL, *victim = &pf->streams[0];
+	int n = 0;
+
+	for (int i = 0; i < STREAM_ENTRIES; i++) {
+		struct stream_entry *cur = &pf->streams[i];
+
+		if (!cur->valid) {
+			if (victim->valid) victim = cur;
+			continue;
+		}
+		long delta = (long)(block - cur->last_block);
+		if (delta >= -STREAM_WINDOW && delta <= STREAM_WINDOW) {
+			s = cur;
+			break;
+		}
+		if (victim->valid && cur->lru < victim->lru) victim = cur;
+	}
+
+	if (s == NULL) {
+		// Only misses start new streams, hits are already covered
+		if (!hit) {
+			*victim = (struct stream_entry){ .last_block = block, .direction = 0, .confidence = 0, .lru = pf->now, .valid = 1 };
+		}
+		return 0;
+	}
+
+	s->lru = pf->now;
+	if (block == s->last_block) {
+		return 0;
+	}
+
+	int direction = block > s->last_block ? 1 : -1;
+	if (s->direction == direction) {
+		s->confidence++;
+	} else {
+		s->direction = direction;
+		s->confidence = 1;
+	}
+	s->last_block = block;
+
+	if (s->confidence >= STREAM_CONFIRM) {
+		for (unsigned long i = 0; i < pf->degree && n < max; i++) {
+			long ahead = (long)(pf->distance + i) * s->direction;
+			out[n++] = (block + ahead) * CACHE_BLOCK_SIZE;
+		}
+	}
+	return n;
+}
+
+
+int prefetcher_observe(struct prefetcher *pf, unsigned long pc, unsigned long mem_addr, int hit,
+		       unsigned long *out, int max) {
+	if (pf == NULL) {
+		return 0;
+	}
+	pf->now++;
+
+	switch (pf->type) {
+	case PREFETCH_NEXTLINE: return nextline_observe(pf, mem_addr, out, max);
+	case PREFETCH_STRIDE:   return stride_observe(pf, pc, mem_addr, out, max);
+	case PREFETCH_STREAM:   return stream_observe(pf, mem_addr, hit, out, max);
+	default:                return 0;
+	}
+}
+
+
+static char *prefetch_names[] = {
+	[PREFETCH_NONE]     = "none",
+	[PREFETCH_NEXTLINE] = "nextline",
+	[PREFETCH_STRIDE]   = "stride",
+	[PREFETCH_STREAM]   = "stream",
+};
+
+enum prefetch_type prefetch_type_parse(char *name) {
+	for (unsigned int i = 0; i < sizeof(prefetch_names) / sizeof(prefetch_names[0]); i++) {
+		if (strcmp(name, prefetch_names[i]) == 0) return (enum prefetch_type)i;
+	}
+	return PREFETCH_NONE;
+}
+
+char *prefetch_type_name(enum prefetch_type type) {
+	if ((unsigned int)type >= sizeof(prefetch_names) / sizeof(prefetch_names[0])) return "unknown";
+	return prefetch_names[type];
+}
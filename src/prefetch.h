@@ -0,0 +1,53 @@
+#pragma once
+
+/*
+ * Hardware prefetcher models that can be attached to any cache
+ * through `cache_set_prefetcher`. A prefetcher only observes the demand
+ * stream of the cache it is attached to and proposes addresses to
+ * bring in; the cache decides whether a proposal is actually issued
+ * (it is not if the line is already present or already in flight) and
+ * keeps all of the issued/useful/late/polluting statistics.
+ */
+enum prefetch_type {
+	PREFETCH_NONE,
+	PREFETCH_NEXTLINE, /* Fetch the lines following every access */
+	PREFETCH_STRIDE,   /* PC-indexed reference prediction table (Chen & Baer) */
+	PREFETCH_STREAM,   /* Sequential stream detection on misses */
+};
+
+/* Most addresses a prefetcher may propose per access */
+#define PREFETCH_DEGREE_MAX 16
+
+/* Define this as you'd like in your .c file. */
+struct prefetcher;
+
+/*
+ * Allocate a prefetcher.
+ *
+ * @param type Which prefetching algorithm to model.
+ * @param degree How many addresses to propose each time the prefetcher triggers, at most
+ *        `PREFETCH_DEGREE_MAX`.
+ * @param distance How far ahead of the current access to prefetch, in lines for
+ *        the next-line and stream prefetchers, and in strides for the stride prefetcher.
+ */
+struct prefetcher *prefetcher_alloc(enum prefetch_type type, unsigned long degree, unsigned long distance);
+void prefetcher_free(struct prefetcher *pf);
+
+/*
+ * Show the prefetcher one demand access, and collect the addresses it
+ * wants to prefetch in response.
+ *
+ * @param pf The prefetcher.
+ * @param pc The address of the load/store that made the access.
+ * @param mem_addr The memory address that was accessed.
+ * @param hit If the access hit in the cache the prefetcher is attached to.
+ * @param out Array that receives the proposed prefetch addresses.
+ * @param max The number of entries in `out`.
+ * @return The number of addresses written into `out`.
+ */
+int prefetcher_observe(struct prefetcher *pf, unsigned long pc, unsigned long mem_addr, int hit,
+		       unsigned long *out, int max);
+
+/* Conversions between the prefetcher types and their command-line names */
+enum prefetch_type prefetch_type_parse(char *name);
+char *prefetch_type_name(enum prefetch_type type);
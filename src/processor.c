@@ -8,12 +8,33 @@
 #include <stdio.h>
 #include <assert.h>
 
+/*
+ * Feed an instruction that executed (leaving the pc after it) to the
+ * timing models and the statistics.
+ */
+static void
+processor_retire(struct processor *p, struct instruction *i, unsigned long pc)
+{
+	if (!p->measuring) return;
+	p->num_instrs++;
+	if (p->pipeline) pipeline_retire(p->pipeline, i, registers_getpc(p->rs) != pc + 4, p->mem_hit, p->mem_addr);
+	if (p->ooo) {
+		enum instr_class class = instr_class(i->inst_no);
+		int mispredicted = (class == CLASS_BRANCH || class == CLASS_JUMP) && bpred_mispredicted(p->bpred);
+
+		ooo_retire(p->ooo, i, mispredicted, p->mem_hit, p->mem_addr);
+	}
+	if (p->ilp) ilp_retire(p->ilp, i, p->mem_hit, p->mem_addr);
+	if (p->interval_stats) interval_stats_record(p->interval_stats, instr_class(i->inst_no), p->cache);
+}
+
 void
 processor_emulate(struct processor *p)
 {
 	unsigned long pc, offset;
 	struct instruction *i;
 	enum exception e;
+	int quiet;
 
 	processor_registers_printall(p);
 	while (1) {
@@ -23,8 +44,12 @@ processor_emulate(struct processor *p)
 		}
 		offset = (pc - p->cfg.instr_lower) / 4; /* each instruction is 4 bytes */
 		i = &p->instrs->instructions[offset];
+		if (p->vm && p->measuring) vm_fetch(p->vm, pc);
+		/* Fast-forwarding prints nothing until the region of interest */
+		quiet = p->cfg.fast_forward && !p->measuring;
 
-		if (p->cfg.print_instrs) instruction_print(i);
+		if (p->cfg.print_instrs && !quiet) instruction_print(i);
+		p->mem_hit = -1;
 
 		if (processor_emulate_regops(p, i, &e) < 0 ||
 			processor_emulate_memops(p, i, &e) < 0 ||
@@ -32,6 +57,12 @@ processor_emulate(struct processor *p)
 			processor_print_exception(p, e);
 			return;
 		}
+		processor_retire(p, i, pc);
+		if (quiet) {
+			/* The region begins: the first instruction printed only shows its own changes */
+			if (p->measuring) processor_registers_sync(p);
+			continue;
+		}
 		processor_memory_print(p);
 		if (p->cfg.print_regs)   processor_registers_print(p);
 		printf("-------------------------------------------------------------------------------------------------------------------\n");
@@ -39,6 +70,109 @@ processor_emulate(struct processor *p)
 }
 
 
+void
+processor_corun(struct processor **ps, unsigned long n, struct cosched *cs)
+{
+	unsigned long running = n, k, j, pc, instrs[COSCHED_PROGRAMS_MAX];
+	int exited[COSCHED_PROGRAMS_MAX] = { 0 };
+	struct processor *p;
+	struct instruction *i;
+	enum exception e;
+
+	assert(n <= COSCHED_PROGRAMS_MAX);
+	while (running > 0) {
+		for (k = 0; k < n; k++) {
+			p = ps[k];
+			if (exited[k]) continue;
+			for (j = 0; j < p->cfg.quantum; j++) {
+				pc = registers_getpc(p->rs);
+				if (p->cfg.instr_lower > pc || p->cfg.instr_upper <= pc) {
+					e = EXCEPTION_INSTRUCTION;
+					break;
+				}
+				i = &p->instrs->instructions[(pc - p->cfg.instr_lower) / 4];
+				if (p->vm && p->measuring) vm_fetch(p->vm, pc);
+				p->mem_hit = -1;
+				if (processor_emulate_regops(p, i, &e) < 0 ||
+				    processor_emulate_memops(p, i, &e) < 0 ||
+				    processor_emulate_cntlflowops(p, i, &e) < 0) break;
+				processor_retire(p, i, pc);
+			}
+			if (j == p->cfg.quantum) continue;
+			printf("Program %lu: ", k);
+			processor_print_exception(p, e);
+			exited[k] = 1;
+			running--;
+		}
+	}
+	for (k = 0; k < n; k++) instrs[k] = ps[k]->num_instrs;
+	cosched_print(cs, instrs);
+}
+
+void
+processor_models_sync(struct processor *p)
+{
+	model_thread_join(p->model_thread);
+	p->model_thread = NULL;
+}
+
+void
+processor_roi(struct processor *p, enum roi_syscall syscall)
+{
+	unsigned long i;
+
+	switch (syscall) {
+	case SYSCALL_ROI_BEGIN:
+		p->measuring = 1;
+		break;
+	case SYSCALL_ROI_END:
+		p->measuring = 0;
+		break;
+	case SYSCALL_ROI_RESET:
+		/* The model thread must be done with the accesses before them */
+		if (p->model_thread) {
+			processor_models_sync(p);
+			p->model_thread = model_thread_start(p);
+		}
+		for (i = 0; i < p->num_caches; i++) cache_stats_reset(p->caches[i]);
+		pc_stats_reset(p->pc_stats);
+		interval_stats_reset(p->interval_stats, p->cache);
+		regions_stats_reset(p->regions);
+		heatmap_stats_reset(p->heatmap);
+		stack_distance_stats_reset(p->sd);
+		coherence_stats_reset(p->coherence);
+		dram_stats_reset(p->dram);
+		vm_stats_reset(p->vm);
+		loopnest_stats_reset(p->loopnest);
+		pipeline_stats_reset(p->pipeline);
+		ooo_stats_reset(p->ooo);
+		bpred_stats_reset(p->bpred);
+		ilp_stats_reset(p->ilp);
+		p->reset_instrs = p->num_instrs;
+		break;
+	}
+}
+
+long
+processor_replay(struct processor *p, struct trace_reader *trace)
+{
+	struct trace_record r;
+	long n = 0;
+	int ret;
+
+	while ((ret = trace_read(trace, &r)) == 1) {
+		p->core = r.core;
+		processor_memory_access(p, r.pc, r.addr, r.size, r.is_store);
+		p->num_instrs++;
+		n++;
+	}
+	if (ret < 0) return -1;
+	processor_models_sync(p);
+	if (p->cfg.print_cache) processor_cache_print(p);
+
+	return n;
+}
+
 struct processor *
 processor_alloc(struct configuration *cfg, struct instructions *instrs, struct registers *rs, struct memory *mem, struct cache *cache)
 {
@@ -51,6 +185,9 @@ processor_alloc(struct configuration *cfg, struct instructions *instrs, struct r
 		.rs = rs,
 		.mem = mem,
 		.cache = cache,
+		.caches = { cache },
+		.num_caches = cache ? 1 : 0,
+		.measuring = !cfg->fast_forward,
 	};
 
 	return p;
@@ -1,6 +1,7 @@
 /*
- * Do NOT change this file. This is the "stable API" for the processor
- * emulator, thus should not be changed.
+ * The API of the processor emulator: its configuration, the state of
+ * the processor and of the models attached to it, and the functions
+ * that emulate it.
  */
 
 #pragma once
@@ -9,6 +10,27 @@
 #include <instructions.h>
 #include <memory.h>
 #include <cache.h>
+#include <stack_distance.h>
+#include <trace.h>
+#include <model_thread.h>
+#include <pc_stats.h>
+#include <regions.h>
+#include <heatmap.h>
+#include <interval_stats.h>
+#include <coherence.h>
+#include <pipeline.h>
+#include <bpred.h>
+#include <ooo.h>
+#include <dram.h>
+#include <vm.h>
+#include <ilp.h>
+#include <cosched.h>
+#include <loopnest.h>
+
+/* Maximum number of cache geometries simulated side by side in one run */
+#define CACHE_CONFIGS_MAX 64
+/* Most `--region` ranges on the command line */
+#define REGION_ARGS_MAX 64
 
 /*
  * Configuration variables for the program and emulator. This includes:
@@ -39,6 +61,145 @@ struct configuration {
 
   /* To be used in the cache homeworks */
 	unsigned long cache_sets, cache_tot_cachelines;
+	/*
+	 * Every cache geometry simulated in this run. Entry 0 is always
+	 * `cache_tot_cachelines`/`cache_sets`, and a list passed to
+	 * `--cache-values` adds the others.
+	 */
+	unsigned long num_cache_configs;
+	unsigned long cache_config_lines[CACHE_CONFIGS_MAX], cache_config_sets[CACHE_CONFIGS_MAX];
+	/*
+	 * Prefetcher attached to the cache (an `enum prefetch_type`), how
+	 * many lines it fetches per trigger and how far ahead, and the
+	 * number of cache accesses a prefetch takes to arrive.
+	 */
+	unsigned long prefetch_type, prefetch_degree, prefetch_distance, prefetch_latency;
+	/* Entries in the victim (or miss) cache behind the cache, and an `enum victim_mode` */
+	unsigned long victim_entries, victim_mode;
+	/* Compute the exact fully-associative LRU miss-ratio curve */
+	unsigned long mrc;
+	/*
+	 * Estimate the curve from a sample of the lines instead (SHARDS):
+	 * the sampling rate (0 to disable), and the maximum number of
+	 * sampled lines (0 for fixed-rate sampling).
+	 */
+	double mrc_sample_rate;
+	unsigned long mrc_sample_lines;
+	/*
+	 * Record the memory accesses into `trace_out` (deflating it if
+	 * `trace_compress`), or replay the accesses in `trace_in` through
+	 * the caches instead of executing a program.
+	 */
+	char *trace_out, *trace_in;
+	unsigned long trace_compress;
+	/* Worker threads simulating each cache, split by set index (0 or 1 for none) */
+	unsigned long cache_threads;
+	/* Run all of the memory models on their own thread, fed through a ring buffer */
+	unsigned long model_thread;
+	/* Report the loads/stores with the most cache misses, this many of them (0 for none) */
+	unsigned long pc_stats;
+	/*
+	 * Report cache misses per data object: the symbols listed (`nm -S`
+	 * format) in `symbol_file`, and `num_regions` ranges given on the
+	 * command line.
+	 */
+	char *symbol_file;
+	unsigned long num_regions;
+	char *region_args[REGION_ARGS_MAX];
+	/*
+	 * Write an address x time heatmap of the main cache's accesses and
+	 * misses to `heatmap_out`, one row per `heatmap_interval`
+	 * instructions, binning addresses by `heatmap_granularity` bytes.
+	 */
+	char *heatmap_out;
+	unsigned long heatmap_interval, heatmap_granularity;
+	/*
+	 * Append the statistics of every `stats_interval` instructions (0
+	 * for none) to `stats_out`, as JSON lines if its name ends in
+	 * `.json` or `.jsonl` and as CSV otherwise.
+	 */
+	unsigned long stats_interval;
+	char *stats_out;
+	/*
+	 * Give each of `coherence_cores` cores (0 for none) a private cache
+	 * of the main cache's geometry, kept coherent with an `enum
+	 * coherence_protocol`.
+	 */
+	unsigned long coherence_cores, coherence_protocol;
+	/*
+	 * Time the execution on an in-order pipeline this many instructions
+	 * wide (0 for none), with this branch penalty and forwarding, and
+	 * the cycles a load/store spends in MEM on a cache hit and miss.
+	 */
+	unsigned long pipeline_width, branch_penalty, forwarding;
+	unsigned long hit_latency, miss_latency;
+	/*
+	 * Simulate the branch predictors in this bitmask (bit `1 <<
+	 * BPRED_*`, 0 for none) side by side, with tables of 2^`bpred_bits`
+	 * counters, and a BTB and return-address stack of this many entries.
+	 */
+	unsigned long bpred_types, bpred_bits, btb_entries, ras_entries;
+	/*
+	 * Time the execution on an out-of-order core with a reorder buffer
+	 * of `ooo_rob` entries (0 for none), `ooo_width` wide, with this
+	 * many rename registers and load/store queue entries, and these
+	 * ALU and branch latencies. Loads take `hit_latency` or
+	 * `miss_latency`, and a mispredict `branch_penalty` cycles.
+	 */
+	unsigned long ooo_rob, ooo_width, ooo_rename, ooo_lq, ooo_sq;
+	unsigned long alu_latency, branch_latency;
+	/*
+	 * MSHRs of the cache in the timing models (0 for a blocking cache
+	 * in the pipeline, and unlimited misses in flight out of order).
+	 */
+	unsigned long mshrs;
+	/*
+	 * Serve the main cache's misses from a DRAM with this many banks (0
+	 * for none) and bytes per row, these timings in core cycles, an
+	 * `enum dram_policy` and an `enum dram_mapping`.
+	 */
+	unsigned long dram_banks, dram_row_size;
+	unsigned long t_rcd, t_cas, t_rp, t_burst;
+	unsigned long dram_policy, dram_mapping;
+	/*
+	 * Translate the image's addresses with Sv39 page tables (if `vm`)
+	 * of `enum vm_page_size` pages, through L1 instruction and data
+	 * TLBs and an L2 TLB of these sizes and ways, an L2 TLB hit taking
+	 * `l2tlb_latency` cycles and page-table reads `hit_latency` or
+	 * `miss_latency`.
+	 */
+	unsigned long vm, vm_page_size;
+	unsigned long itlb_entries, itlb_ways, dtlb_entries, dtlb_ways;
+	unsigned long l2tlb_entries, l2tlb_ways, l2tlb_latency;
+	/*
+	 * Measure the dataflow ILP limit with each of these `num_ilp_windows`
+	 * instruction windows (0 for none), taking `alu_latency`,
+	 * `branch_latency`, and `hit_latency` or `miss_latency` for loads.
+	 */
+	unsigned long num_ilp_windows;
+	unsigned long ilp_windows[ILP_WINDOWS_MAX];
+	/*
+	 * Co-schedule these `num_programs` programs (0 to run the one on
+	 * stdin), taking turns of `quantum` instructions, each with a
+	 * private L1 of `l1_lines`/`l1_sets` in front of a shared cache of
+	 * `llc_lines`/`llc_sets` (the main cache's geometry if it is given),
+	 * partitioned by `way_masks` if they are given (one per program).
+	 */
+	unsigned long num_programs, quantum, l1_lines, l1_sets, llc_lines, llc_sets;
+	char *programs[COSCHED_PROGRAMS_MAX];
+	unsigned long num_way_masks;
+	unsigned long way_masks[COSCHED_PROGRAMS_MAX];
+	/*
+	 * Predict each load/store's misses in the main cache from the
+	 * program's loop nests: 1 prints the predictions without running
+	 * the program, 2 runs it and prints them next to the actual ones.
+	 */
+	unsigned long predict;
+	/*
+	 * Run functionally until the program's region of interest begins
+	 * (the `SYSCALL_ROI_BEGIN` ecall): no models, no printing.
+	 */
+	unsigned long fast_forward;
 };
 
 struct processor {
@@ -51,6 +212,82 @@ struct processor {
 	struct memory *mem;
   /* Populated and used in the cache homeworks */
 	struct cache *cache;
+	/*
+	 * One cache per configuration, all fed the same accesses.
+	 * `caches[0]` is `cache`.
+	 */
+	struct cache *caches[CACHE_CONFIGS_MAX];
+	unsigned long num_caches;
+	/* Stack-distance analyzer, if the miss-ratio curve is requested */
+	struct stack_distance *sd;
+	/* Accesses and misses in `cache` for each load/store, if reported */
+	struct pc_stats *pc_stats;
+	/* Accesses, misses and lines touched per data object, if reported */
+	struct regions *regions;
+	/* Accesses and misses binned by address and time, if requested */
+	struct heatmap *heatmap;
+	/* Private caches and their coherence directory, if modeled */
+	struct coherence *coherence;
+	/* In-order pipeline timing, if modeled */
+	struct pipeline *pipeline;
+	/* Branch predictors fed every branch and jump, if simulated */
+	struct bpred *bpred;
+	/* Out-of-order core timing, if modeled */
+	struct ooo *ooo;
+	/*
+	 * The DRAM the main cache's misses go to, one instruction per
+	 * cycle, if there is one and no timing model (which have their own)
+	 */
+	struct dram *dram;
+	/* Page tables and TLBs translating fetches and loads/stores, if modeled */
+	struct vm *vm;
+	/* Dataflow ILP limit study fed every instruction, if requested */
+	struct ilp *ilp;
+	/*
+	 * The cache shared with the programs co-scheduled with this one,
+	 * which `cache` (its private L1) misses to, and its number there.
+	 */
+	struct cosched *cosched;
+	unsigned long program;
+	/* Static predictions of the main cache's misses, if they are verified */
+	struct loopnest *loopnest;
+	/*
+	 * Whether the current instruction's access hit in `cache`: 1 or
+	 * 0, and -1 if it made none, and the address it accessed.
+	 */
+	int mem_hit;
+	unsigned long mem_addr;
+	/* Where the statistics of each interval are written, if they are */
+	struct interval_stats *interval_stats;
+	/* Where the memory accesses are recorded, if they are */
+	struct trace_writer *trace;
+	/*
+	 * The thread running the models above, if `cfg.model_thread`.
+	 * While it runs, the models must only be used through it.
+	 */
+	struct model_thread *model_thread;
+	/*
+	 * Instructions executed so far (trace records, when replaying),
+	 * and its value at the access the models are processing, which
+	 * lags behind with a model thread. The count keeps going when
+	 * the statistics are reset, as it is the models' clock.
+	 */
+	unsigned long num_instrs, model_time;
+	/*
+	 * `num_instrs` at the last statistics reset (ecall 26): the
+	 * per-instruction rates count from there.
+	 */
+	unsigned long reset_instrs;
+	/*
+	 * The core making the current access (0 unless replaying a
+	 * multi-core trace), and the core of the access being modeled.
+	 */
+	unsigned int core, model_core;
+	/*
+	 * Whether the instructions and accesses go to the models: 0 while
+	 * fast-forwarding and outside the region of interest.
+	 */
+	int measuring;
 };
 
 /*
@@ -84,6 +321,17 @@ enum exception {
   EXCEPTION_UNKNOWN_SYSCALL,
 };
 
+/*
+ * The system calls (in `a7`) marking the program's region of
+ * interest, besides `2` (exit) and `23` (print the registers): begin
+ * and end measuring, and zero the statistics measured so far.
+ */
+enum roi_syscall {
+  SYSCALL_ROI_BEGIN = 24,
+  SYSCALL_ROI_END   = 25,
+  SYSCALL_ROI_RESET = 26,
+};
+
 /*
  * The following functions emulate a single instruction's execution.
  * This execution will make changes in the processor's `registers` and
@@ -130,6 +378,47 @@ int processor_emulate_regops(struct processor *processor, struct instruction *i,
  */
 int processor_emulate_memops(struct processor *processor, struct instruction *i, enum exception *e);
 
+/*
+ * Send one load/store through the memory models: every configured
+ * cache, the stack-distance analyzer, and the trace. The memory
+ * operations call this for each access, and trace replay calls it for
+ * each record. With a model thread, the access is only queued for it
+ * (see `processor_models_sync`).
+ *
+ * - `@processor` - The processor whose models see the access.
+ * - `@pc` - The address of the load/store instruction.
+ * - `@addr` - The memory address accessed.
+ * - `@size` - The number of bytes accessed.
+ * - `@is_store` - `1` for stores, `0` for loads.
+ */
+void processor_memory_access(struct processor *processor, unsigned long pc, unsigned long addr, unsigned long size, int is_store);
+
+/*
+ * The work of `processor_memory_access`, done right away: with a
+ * model thread, `processor_memory_access` only queues the access and
+ * the model thread calls this.
+ *
+ * @return 1 if the access hit in `cache`, 0 if it missed, -1 if there is none.
+ */
+int processor_models_access(struct processor *processor, unsigned long pc, unsigned long addr, unsigned long size, int is_store);
+
+/*
+ * Wait for the model thread (if any) to finish the queued accesses
+ * and stop it, so the models can be read. Memory accesses after this
+ * are modeled synchronously.
+ */
+void processor_models_sync(struct processor *processor);
+
+/*
+ * Handle a region-of-interest system call: begin or end feeding the
+ * models, or zero the statistics of the caches, the per-pc counters
+ * and the instruction count (the caches keep their contents).
+ *
+ * - `@processor` - The processor executing the `ecall`.
+ * - `@syscall` - One of `enum roi_syscall`.
+ */
+void processor_roi(struct processor *processor, enum roi_syscall syscall);
+
 /*
  * Emulate a single instruction if it only performs control flow
  * operations including conditionals or jumps. If the instruction at
@@ -168,11 +457,39 @@ int processor_emulate_cntlflowops(struct processor *processor, struct instructio
  */
 void processor_emulate(struct processor *p);
 
+/*
+ * Run several programs, one per processor, round-robin: each executes
+ * `quantum` instructions in turn, until all of them have exited. The
+ * instructions and registers aren't printed as they execute; each
+ * program's state is printed as it exits, and the shared cache's
+ * report once they all have.
+ *
+ * - `@processors` - The programs, each with its own registers, memory
+ *   and L1 cache, all missing to `cosched`.
+ * - `@num` - The number of programs.
+ * - `@cosched` - The cache they share.
+ */
+void processor_corun(struct processor **processors, unsigned long num, struct cosched *cosched);
+
+/*
+ * Feed every access in a trace through `processor_memory_access`
+ * without executing any instructions, then print the cache state.
+ *
+ * - `@processor` - The processor holding the memory models. It doesn't
+ *   need instructions, registers, or memory.
+ * - `@trace` - The trace to replay.
+ * - `@return` - The number of accesses replayed, or `-1` if the trace
+ *   is corrupt.
+ */
+long processor_replay(struct processor *p, struct trace_reader *trace);
+
 struct processor *processor_alloc(struct configuration *cfg, struct instructions *instrs, struct registers *rs, struct memory *mem, struct cache *cache);
 void processor_free(struct processor *p);
 
 /* Print out processor information */
 void processor_registers_print(struct processor *p);
+/* Take the registers as printed, for the next `processor_registers_print` */
+void processor_registers_sync(struct processor *p);
 void processor_registers_printall(struct processor *p);
 void processor_memory_print(struct processor *p);
 
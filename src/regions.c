@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "regions.h"
+#include "cache.h"
+
+#define REGION_NAME_MAX 64
+
+struct region {
+	char name[REGION_NAME_MAX];
+	unsigned long start, size;
+	unsigned long accesses, misses;
+	unsigned long *touched; // One bit per cache line of the range, set once it is accessed
+	unsigned long num_touched;
+	unsigned long reach; // The furthest end of this range and of those sorted before it
+};
+
+struct regions {
+	struct region *regions; // Sorted by start address once `sorted` is set
+	unsigned long count, capacity;
+	int sorted;
+	unsigned long other_accesses, other_misses;
+};
+
+
+struct regions *regions_alloc(void) {
+	struct regions *r = (struct regions *)calloc(1, sizeof(struct regions));
+
+	if (r == NULL) {
+		perror("Failed to allocate data regions");
+		return NULL;
+	}
+
+	return r;
+}
+
+
+void regions_free(struct regions *r) {
+	if (r == NULL) return;
+	for (unsigned long i = 0; i < r->count; i++) {
+		free(r->regions[i].touched);
+	}
+	free(r->regions);
+	free(r);
+}
+
+
+int regions_add(struct regions *r, const char *name, unsigned long start, unsigned long size) {
+	struct region *reg;
+	unsigned long num_lines;
+
+	if (r == NULL || size == 0) return -1;
+	if (r->count == r->capacity) {
+		unsigned long capacity = r->capacity ? r->capacity * 2 : 16;
+		struct region *regions = (struct region *)realloc(r->regions, capacity * sizeof(struct region));
+
+		if (regions == NULL) {
+			perror("Failed to grow data regions");
+			return -1;
+		}
+		r->regions = regions;
+		r->capacity = capacity;
+	}
+
+	// The lines the range overlaps, including partial ones at either end
+	num_lines = (start + size - 1) / CACHE_BLOCK_SIZE - start / CACHE_BLOCK_SIZE + 1;
+	reg = &r->regions[r->count];
+	memset(reg, 0, sizeof(struct region));
+	snprintf(reg->name, REGION_NAME_MAX, "%s", name);
+	reg->start = start;
+	reg->size = size;
+	reg->touched = (unsigned long *)calloc((num_lines + 63) / 64, sizeof(unsigned long));
+	if (reg->touched == NULL) {
+		perror("Failed to allocate data region lines");
+		return -1;
+	}
+	r->count++;
+	r->sorted = 0;
+
+	return 0;
+}
+
+
+struct symbol {
+	char name[REGION_NAME_MAX];
+	unsigned long addr, size; // size is 0 if the listing didn't give one
+};
+
+static int symbol_cmp(const void *a, const void *b) {
+	const struct symbol *x = (const struct symbol *)a, *y = (const struct symbol *)b;
+
+	return x->addr < y->addr ? -1 : (x->addr > y->addr);
+}
+
+
+long regions_load_symbols(struct regions *r, const char *path, unsigned long mem_end) {
+	struct symbol *syms = NULL;
+	unsigned long n = 0, capacity = 0;
+	long added = 0;
+	char line[256];
+	FILE *f = fopen(path, "r");
+
+	if (f == NULL) {
+		perror("Failed to open symbol file");
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f) != NULL) {
+		struct symbol s = { 0 };
+		char field[4][REGION_NAME_MAX];
+		char type;
+		int nf = sscanf(line, "%63s %63s %63s %63s", field[0], field[1], field[2], field[3]);
+
+		// "<addr> <size> <type> <name>" from `nm -S`, or "<addr> <type> <name>" from `nm`.
+		// Types like B and D are also hex digits, so count the fields rather than parse greedily.
+		if (nf == 4 && strlen(field[2]) == 1) {
+			s.addr = strtoul(field[0], NULL, 16);
+			s.size = strtoul(field[1], NULL, 16);
+			type = field[2][0];
+			snprintf(s.name, REGION_NAME_MAX, "%s", field[3]);
+		} else if (nf == 3 && strlen(field[1]) == 1) {
+			s.addr = strtoul(field[0], NULL, 16);
+			type = field[1][0];
+			snprintf(s.name, REGION_NAME_MAX, "%s", field[2]);
+		} else {
+			continue;
+		}
+		// Only data objects: bss, data, read-only data, and small data
+		if (strchr("bBdDrRgGsS", type) == NULL) continue;
+		if (n == capacity) {
+			struct symbol *grown;
+
+			capacity = capacity ? capacity * 2 : 64;
+			grown = (struct symbol *)realloc(syms, capacity * sizeof(struct symbol));
+			if (grown == NULL) {
+				perror("Failed to read symbol file");
+				free(syms);
+				fclose(f);
+				return -1;
+			}
+			syms = grown;
+		}
+		syms[n++] = s;
+	}
+	fclose(f);
+
+	qsort(syms, n, sizeof(struct symbol), symbol_cmp);
+	for (unsigned long i = 0; i < n; i++) {
+		unsigned long size = syms[i].size;
+
+		if (size == 0) {
+			unsigned long end = i + 1 < n ? syms[i + 1].addr : mem_end;
+
+			if (end <= syms[i].addr) continue;
+			size = end - syms[i].addr;
+		}
+		if (regions_add(r, syms[i].name, syms[i].addr, size) != 0) {
+			free(syms);
+			return -1;
+		}
+		added++;
+	}
+	free(syms);
+
+	return added;
+}
+
+
+static int region_cmp(const void *a, const void *b) {
+	const struct region *x = (const struct region *)a, *y = (const struct region *)b;
+
+	// Of two ranges starting together, the inner one comes last and is found first
+	if (x->start == y->start) return x->size > y->size ? -1 : (x->size < y->size);
+	return x->start < y->start ? -1 : (x->start > y->start);
+}
+
+
+// The range containing the address, or NULL
+static struct region *regions_find(struct regions *r, unsigned long mem_addr) {
+	unsigned long lo = 0, hi = r->count;
+
+	if (!r->sorted) {
+		qsort(r->regions, r->count, sizeof(struct region), region_cmp);
+		for (unsigned long i = 0; i < r->count; i++) {
+			unsigned long end = r->regions[i].start + r->regions[i].size;
+
+			r->regions[i].reach = i > 0 && r->regions[i - 1].reach > end ? r->regions[i - 1].reach : end;
+		}
+		r->sorted = 1;
+	}
+	// Binary search for the last range starting at or before the address
+	while (lo < hi) {
+		unsigned long mid = (lo + hi) / 2;
+
+		if (r->regions[mid].start <= mem_addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	// Ranges may nest or overlap: go back through the earlier ones while any still covers it
+	for (; lo > 0 && r->regions[lo - 1].reach > mem_addr; lo--) {
+		if (mem_addr - r->regions[lo - 1].start < r->regions[lo - 1].size) return &r->regions[lo - 1];
+	}
+	return NULL;
+}
+
+
+void regions_record(struct regions *r, unsigned long mem_addr, int miss) {
+	struct region *reg;
+
+	if (r == NULL) return;
+	reg = regions_find(r, mem_addr);
+	if (reg == NULL) {
+		r->other_accesses++;
+		if (miss) r->other_misses++;
+		return;
+	}
+	reg->accesses++;
+	if (miss) reg->misses++;
+
+	unsigned long line = mem_addr / CACHE_BLOCK_SIZE - reg->start / CACHE_BLOCK_SIZE;
+	unsigned long bit = 1UL << (line % 64);
+
+	if (!(reg->touched[line / 64] & bit)) {
+		reg->touched[line / 64] |= bit;
+		reg->num_touched++;
+	}
+}
+
+
+void regions_stats_reset(struct regions *r) {
+	if (r == NULL) return;
+	for (unsigned long i = 0; i < r->count; i++) {
+		struct region *reg = &r->regions[i];
+		unsigned long lines = (reg->start + reg->size - 1) / CACHE_BLOCK_SIZE - reg->start / CACHE_BLOCK_SIZE + 1;
+
+		reg->accesses = reg->misses = 0;
+		memset(reg->touched, 0, (lines + 63) / 64 * sizeof(unsigned long));
+		reg->num_touched = 0;
+	}
+	r->other_accesses = r->other_misses = 0;
+}
+
+
+void regions_print(struct regions *r) {
+	if (r == NULL) return;
+
+	printf("Data Regions:\n");
+	printf("%-20s %18s %10s %14s %14s %10s %10s\n", "Name", "Start", "Size", "Accesses", "Misses", "Miss Rate", "Lines");
+	for (unsigned long i = 0; i < r->count; i++) {
+		struct region *reg = &r->regions[i];
+
+		printf("%-20s %#18lx %10lu %14lu %14lu %9.2f%% %10lu\n", reg->name, reg->start, reg->size,
+			reg->accesses, reg->misses,
+			reg->accesses == 0 ? 0.0 : ((double)reg->misses / (double)reg->accesses) * 100.0,
+			reg->num_touched);
+	}
+	printf("%-20s %18s %10s %14lu %14lu %9.2f%% %10s\n", "(other)", "-", "-",
+		r->other_accesses, r->other_misses,
+		r->other_accesses == 0 ? 0.0 : ((double)r->other_misses / (double)r->other_accesses) * 100.0, "-");
+}
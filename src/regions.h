@@ -0,0 +1,53 @@
+#pragma once
+
+/*
+ * Data-centric cache statistics: accesses, misses, and distinct lines touched, aggregated
+ * per named range of data addresses (an array, a buffer, a heap object...). Ranges come
+ * from the data symbols of the program (the `nm` listing of its ELF) or from the command
+ * line, and accesses outside all of them are counted together.
+ */
+
+/* Define this as you'd like in your .c file. */
+struct regions;
+
+struct regions *regions_alloc(void);
+void regions_free(struct regions *r);
+
+/*
+ * Add a named range of addresses.
+ *
+ * @param r The regions.
+ * @param name The name reported for the range (copied).
+ * @param start The first address of the range.
+ * @param size The number of bytes in the range.
+ * @return 0 on success, -1 on error.
+ */
+int regions_add(struct regions *r, const char *name, unsigned long start, unsigned long size);
+
+/*
+ * Add the data objects (`.bss`, `.data` and `.rodata` symbols) of a symbol listing in the
+ * format of `nm -S` ("<address> [<size>] <type> <name>" per line, in hex). A symbol
+ * without a size extends to the next data symbol, or to `mem_end` for the last one.
+ *
+ * @param r The regions.
+ * @param path The listing, e.g. from `riscv64-unknown-elf-nm -S prog.elf > prog.sym`.
+ * @param mem_end The end of the program's memory, 0 if it isn't known.
+ * @return The number of symbols added, or -1 on error.
+ */
+long regions_load_symbols(struct regions *r, const char *path, unsigned long mem_end);
+
+/*
+ * Count one access. Ranges may nest or overlap: the access is counted in the range that
+ * starts closest before the address among those containing it.
+ *
+ * @param r The regions.
+ * @param mem_addr The memory address accessed.
+ * @param miss Non-zero if the access missed in the cache.
+ */
+void regions_record(struct regions *r, unsigned long mem_addr, int miss);
+
+/* Zero the accesses, misses and lines touched of every range, and outside them */
+void regions_stats_reset(struct regions *r);
+
+/* Print the statistics of every range, and of the accesses outside them */
+void regions_print(struct regions *r);
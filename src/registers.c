@@ -282,11 +282,15 @@ processor_emulate_regops(struct processor *processor, struct instruction *inst,
         case ECALL: {
             u64_t syscall_num = registers_getreg(processor->rs, 17);
             if (syscall_num == 23) {
-                if (processor->cfg.print_regs) { 
+                if (processor->cfg.print_regs && (processor->measuring || !processor->cfg.fast_forward)) { 
                     processor_registers_printall(processor);
                 }
                 registers_setpc(processor->rs, pc + 4);
                 return 1; 
+            } else if (syscall_num == SYSCALL_ROI_BEGIN || syscall_num == SYSCALL_ROI_END || syscall_num == SYSCALL_ROI_RESET) {
+                processor_roi(processor, syscall_num);
+                registers_setpc(processor->rs, pc + 4);
+                return 1;
             } else if (syscall_num == 2) {
                 *e = EXCEPTION_EXIT;
                 return -1; 
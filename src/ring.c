@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <time.h>
+#include "ring.h"
+
+// Keep the producer's and the consumer's indices on different cache lines
+#define RING_PAD 64
+
+struct ring {
+	_Atomic unsigned long head; // Next slot the consumer reads, written by the consumer
+	char pad0[RING_PAD - sizeof(unsigned long)];
+	_Atomic unsigned long tail; // Next slot the producer writes, written by the producer
+	_Atomic int closed;
+	char pad1[RING_PAD - sizeof(unsigned long) - sizeof(int)];
+	unsigned long mask;         // Capacity - 1
+	unsigned long *slots;
+};
+
+
+struct ring *ring_alloc(unsigned long num_slots) {
+	unsigned long size = 1;
+	struct ring *r;
+
+	while (size < num_slots) size *= 2;
+	r = (struct ring *)calloc(1, sizeof(struct ring));
+	if (r == NULL) {
+		perror("Failed to allocate ring");
+		return NULL;
+	}
+	r->slots = (unsigned long *)malloc(size * sizeof(unsigned long));
+	if (r->slots == NULL) {
+		perror("Failed to allocate ring slots");
+		free(r);
+		return NULL;
+	}
+	r->mask = size - 1;
+	atomic_init(&r->head, 0);
+	atomic_init(&r->tail, 0);
+	atomic_init(&r->closed, 0);
+
+	return r;
+}
+
+
+void ring_free(struct ring *r) {
+	if (r == NULL) return;
+	free(r->slots);
+	free(r);
+}
+
+
+void ring_push(struct ring *r, const unsigned long *vals, unsigned long n) {
+	unsigned long tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+	// Wait for the consumer to free enough slots
+	while (tail + n - atomic_load_explicit(&r->head, memory_order_acquire) > r->mask + 1) {
+		sched_yield();
+	}
+	for (unsigned long i = 0; i < n; i++) {
+		r->slots[(tail + i) & r->mask] = vals[i];
+	}
+	// Publish the values (release: the slots are written before the new tail is seen)
+	atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+}
+
+
+unsigned long ring_pop(struct ring *r, unsigned long *vals, unsigned long max) {
+	unsigned long head = atomic_load_explicit(&r->head, memory_order_relaxed);
+	unsigned long avail = atomic_load_explicit(&r->tail, memory_order_acquire) - head;
+	unsigned long n = avail < max ? avail : max;
+
+	for (unsigned long i = 0; i < n; i++) {
+		vals[i] = r->slots[(head + i) & r->mask];
+	}
+	if (n > 0) atomic_store_explicit(&r->head, head + n, memory_order_release);
+
+	return n;
+}
+
+
+unsigned long ring_pop_wait(struct ring *r, unsigned long *vals, unsigned long max) {
+	unsigned long n, idle = 0;
+
+	while ((n = ring_pop(r, vals, max)) == 0) {
+		if (ring_finished(r)) return 0;
+		// Spin briefly, then back off so an idle consumer doesn't steal the producer's core
+		if (++idle < 64) {
+			sched_yield();
+		} else {
+			nanosleep(&(struct timespec){ .tv_nsec = 50000 }, NULL);
+		}
+	}
+
+	return n;
+}
+
+
+void ring_close(struct ring *r) {
+	atomic_store_explicit(&r->closed, 1, memory_order_release);
+}
+
+
+int ring_finished(struct ring *r) {
+	// Check closed before the indices: values pushed before the close are still seen
+	if (!atomic_load_explicit(&r->closed, memory_order_acquire)) return 0;
+	return atomic_load_explicit(&r->head, memory_order_relaxed) == atomic_load_explicit(&r->tail, memory_order_acquire);
+}
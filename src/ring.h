@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+ * A lock-free single-producer/single-consumer ring buffer of `unsigned long` values, used
+ * to hand memory accesses from the emulator's thread to cache simulation threads. Values
+ * are pushed and popped in batches so that the shared head/tail indices are only touched
+ * once per batch, not once per value.
+ */
+
+/* Define this as you'd like in your .c file. */
+struct ring;
+
+/*
+ * Allocate a ring.
+ *
+ * @param num_slots Capacity in values, rounded up to a power of two.
+ * @return The ring, or NULL on allocation failure.
+ */
+struct ring *ring_alloc(unsigned long num_slots);
+void ring_free(struct ring *r);
+
+/*
+ * Producer side: append `n` values, waiting for the consumer to make room if the ring is
+ * full. `n` must not exceed the ring's capacity.
+ */
+void ring_push(struct ring *r, const unsigned long *vals, unsigned long n);
+
+/*
+ * Consumer side: remove up to `max` values into `vals` without waiting.
+ *
+ * @return The number of values removed, 0 if the ring is empty.
+ */
+unsigned long ring_pop(struct ring *r, unsigned long *vals, unsigned long max);
+
+/*
+ * Consumer side: like `ring_pop`, but wait for values to arrive.
+ *
+ * @return The number of values removed, 0 once the ring is closed and empty.
+ */
+unsigned long ring_pop_wait(struct ring *r, unsigned long *vals, unsigned long max);
+
+/* Producer side: the consumer won't be sent anything else. */
+void ring_close(struct ring *r);
+/* Consumer side: the ring is closed and every value in it was popped. */
+int ring_finished(struct ring *r);
@@ -0,0 +1,400 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+#include "stack_distance.h"
+
+// Initial sizes of the growable tables, all are doubled as needed
+#define SD_INITIAL_TIMES 1024
+#define SD_INITIAL_LINES 1024
+// Lines are sampled if their spatial hash, in [0, SD_HASH_SPACE), is below the threshold
+#define SD_HASH_SPACE (1UL << 24)
+
+// A line's entry in the open-addressing hash table: when it was last accessed
+struct sd_entry {
+	unsigned long block; // Line number + 1, so 0 marks an empty slot
+	unsigned long time;  // Index of its last access in the Fenwick tree (1-based)
+};
+
+struct stack_distance {
+	// Fenwick tree with a 1 at the time of every line's most recent access
+	unsigned long *tree;
+	unsigned long tree_size; // Number of times the tree can hold
+	unsigned long now;       // Last time handed out
+
+	// Line -> last access time
+	struct sd_entry *lines;
+	unsigned long lines_size; // Power of two
+	unsigned long num_lines;  // Distinct lines seen so far
+
+	// hist[d] counts the (sampled) accesses with stack distance d among the sampled lines
+	double *hist;
+	unsigned long hist_size;
+	unsigned long num_accesses, num_cold;
+	double weight_accesses, weight_cold; // The two counts above, rescaled like hist
+
+	/*
+	 * SHARDS sampling (Waldspurger et al., FAST'15). Only the lines whose hash is below
+	 * `threshold` are tracked, so the sampling rate is threshold / SD_HASH_SPACE and a
+	 * distance d among sampled lines stands for a distance of d / rate among all lines.
+	 * In fixed-size mode, `max_lines` bounds the sampled lines: the one with the largest
+	 * hash is dropped, and the threshold lowered to its hash, whenever there are too many.
+	 * What was counted at the previous rate is then scaled down to the new one.
+	 */
+	unsigned long threshold;
+	unsigned long max_lines;      // 0 for fixed-rate sampling
+	unsigned long total_accesses; // All accesses, sampled or not
+	unsigned long *heap;          // Max-heap of the sampled lines' blocks, by hash (fixed-size only)
+	unsigned long heap_size;
+};
+
+
+static void fenwick_add(struct stack_distance *sd, unsigned long i, long v) {
+	for (; i <= sd->tree_size; i += i & -i) sd->tree[i] += v;
+}
+
+// Sum of the tree over [1, i]
+static unsigned long fenwick_sum(struct stack_distance *sd, unsigned long i) {
+	unsigned long s = 0;
+
+	for (; i > 0; i -= i & -i) s += sd->tree[i];
+	return s;
+}
+
+
+// Home slot of a line in the hash table (a murmur3 finalizer)
+static inline unsigned long sd_slot(struct stack_distance *sd, unsigned long block) {
+	block ^= block >> 33;
+	block *= 0xFF51AFD7ED558CCDUL;
+	block ^= block >> 33;
+	return block & (sd->lines_size - 1);
+}
+
+// Spatial hash used to decide which lines are sampled, independent of the slot hash
+static inline unsigned long sd_sample_hash(unsigned long block) {
+	return (block * 0x9E3779B97F4A7C15UL) >> (64 - 24);
+}
+
+// Find the hash table slot of a line, or the empty slot where it would go
+static struct sd_entry *sd_lookup(struct stack_distance *sd, unsigned long block) {
+	unsigned long mask = sd->lines_size - 1;
+	unsigned long i = sd_slot(sd, block);
+
+	while (sd->lines[i].block != 0 && sd->lines[i].block != block + 1) i = (i + 1) & mask;
+	return &sd->lines[i];
+}
+
+// Remove a line from the hash table, shifting back the entries probed past it
+static void sd_remove(struct stack_distance *sd, struct sd_entry *e) {
+	unsigned long mask = sd->lines_size - 1;
+	unsigned long i = (unsigned long)(e - sd->lines), j = i;
+
+	while (1) {
+		j = (j + 1) & mask;
+		if (sd->lines[j].block == 0) break;
+
+		unsigned long home = sd_slot(sd, sd->lines[j].block - 1);
+		// Move j into the hole at i, unless its home slot lies cyclically in (i, j]
+		if ((i <= j) ? (home <= i || home > j) : (home <= i && home > j)) {
+			sd->lines[i] = sd->lines[j];
+			i = j;
+		}
+	}
+	sd->lines[i].block = 0;
+}
+
+
+// Double the hash table once it is half full
+static int sd_grow_lines(struct stack_distance *sd) {
+	struct sd_entry *old = sd->lines;
+	unsigned long old_size = sd->lines_size;
+
+	sd->lines = (struct sd_entry *)calloc(old_size * 2, sizeof(struct sd_entry));
+	if (sd->lines == NULL) {
+		sd->lines = old;
+		return -1;
+	}
+	sd->lines_size = old_size * 2;
+	for (unsigned long i = 0; i < old_size; i++) {
+		if (old[i].block != 0) *sd_lookup(sd, old[i].block - 1) = old[i];
+	}
+	free(old);
+	return 0;
+}
+
+
+static int cmp_entry_time(const void *a, const void *b) {
+	const struct sd_entry *x = *(struct sd_entry * const *)a, *y = *(struct sd_entry * const *)b;
+
+	return (x->time > y->time) - (x->time < y->time);
+}
+
+/*
+ * The tree ran out of times. Only one time per line is live, so renumber the live times
+ * 1..num_lines (keeping their order), and rebuild a tree with room for as many new ones.
+ */
+static int sd_compact(struct stack_distance *sd) {
+	unsigned long size = sd->num_lines * 2 > SD_INITIAL_TIMES ? sd->num_lines * 2 : SD_INITIAL_TIMES;
+	struct sd_entry **order = (struct sd_entry **)malloc(sd->num_lines * sizeof(struct sd_entry *) + 1);
+	unsigned long *tree = (unsigned long *)calloc(size + 1, sizeof(unsigned long));
+	unsigned long n = 0;
+
+	if (order == NULL || tree == NULL) {
+		free(order);
+		free(tree);
+		return -1;
+	}
+	for (unsigned long i = 0; i < sd->lines_size; i++) {
+		if (sd->lines[i].block != 0) order[n++] = &sd->lines[i];
+	}
+	qsort(order, n, sizeof(struct sd_entry *), cmp_entry_time);
+
+	free(sd->tree);
+	sd->tree = tree;
+	sd->tree_size = size;
+	for (unsigned long i = 0; i < n; i++) {
+		order[i]->time = i + 1;
+		fenwick_add(sd, i + 1, 1);
+	}
+	sd->now = n;
+	free(order);
+	return 0;
+}
+
+
+static void heap_swap(unsigned long *a, unsigned long *b) {
+	unsigned long t = *a;
+
+	*a = *b;
+	*b = t;
+}
+
+static void heap_push(struct stack_distance *sd, unsigned long block) {
+	unsigned long i = sd->heap_size++;
+
+	sd->heap[i] = block;
+	while (i > 0 && sd_sample_hash(sd->heap[(i - 1) / 2]) < sd_sample_hash(sd->heap[i])) {
+		heap_swap(&sd->heap[(i - 1) / 2], &sd->heap[i]);
+		i = (i - 1) / 2;
+	}
+}
+
+static unsigned long heap_pop(struct stack_distance *sd) {
+	unsigned long top = sd->heap[0], i = 0;
+
+	sd->heap[0] = sd->heap[--sd->heap_size];
+	while (1) {
+		unsigned long l = 2 * i + 1, r = l + 1, m = i;
+
+		if (l < sd->heap_size && sd_sample_hash(sd->heap[l]) > sd_sample_hash(sd->heap[m])) m = l;
+		if (r < sd->heap_size && sd_sample_hash(sd->heap[r]) > sd_sample_hash(sd->heap[m])) m = r;
+		if (m == i) break;
+		heap_swap(&sd->heap[i], &sd->heap[m]);
+		i = m;
+	}
+	return top;
+}
+
+/*
+ * Fixed-size sampling: too many lines are sampled, so lower the threshold to the largest
+ * sampled hash and drop every line at or above it. The distances and counts already
+ * recorded were measured at the old rate, so they are rescaled to the new one.
+ */
+static void sd_lower_threshold(struct stack_distance *sd) {
+	unsigned long old = sd->threshold;
+	double scale;
+
+	sd->threshold = sd_sample_hash(sd->heap[0]);
+	while (sd->heap_size > 0 && sd_sample_hash(sd->heap[0]) >= sd->threshold) {
+		struct sd_entry *e = sd_lookup(sd, heap_pop(sd));
+
+		fenwick_add(sd, e->time, -1);
+		sd_remove(sd, e);
+		sd->num_lines--;
+	}
+	scale = (double)sd->threshold / old;
+	sd->hist[0] *= scale;
+	for (unsigned long d = 1; d < sd->hist_size; d++) {
+		// Split the count between the two buckets around d * scale, so that
+		// repeated rescaling doesn't drift the distances downwards
+		double nd = d * scale, count = sd->hist[d] * scale;
+		unsigned long lo = (unsigned long)nd;
+
+		sd->hist[d] = 0;
+		sd->hist[lo] += count * (1.0 - (nd - lo));
+		sd->hist[lo + 1] += count * (nd - lo);
+	}
+	sd->weight_accesses *= scale;
+	sd->weight_cold *= scale;
+}
+
+
+struct stack_distance *stack_distance_alloc(void) {
+	return stack_distance_alloc_sampled(1.0, 0);
+}
+
+
+struct stack_distance *stack_distance_alloc_sampled(double rate, unsigned long max_lines) {
+	if (rate <= 0.0 || rate > 1.0) {
+		fprintf(stderr, "Error: The sampling rate must be in (0, 1].\n");
+		return NULL;
+	}
+
+	struct stack_distance *sd = (struct stack_distance *)calloc(1, sizeof(struct stack_distance));
+	if (sd == NULL) {
+		perror("Failed to allocate stack distance analyzer");
+		return NULL;
+	}
+
+	sd->tree_size = SD_INITIAL_TIMES;
+	sd->lines_size = SD_INITIAL_LINES;
+	sd->hist_size = SD_INITIAL_LINES;
+	sd->threshold = (unsigned long)(rate * SD_HASH_SPACE);
+	if (sd->threshold == 0) sd->threshold = 1;
+	sd->max_lines = max_lines;
+	sd->tree = (unsigned long *)calloc(sd->tree_size + 1, sizeof(unsigned long));
+	sd->lines = (struct sd_entry *)calloc(sd->lines_size, sizeof(struct sd_entry));
+	sd->hist = (double *)calloc(sd->hist_size, sizeof(double));
+	if (max_lines > 0) sd->heap = (unsigned long *)malloc((max_lines + 1) * sizeof(unsigned long));
+	if (sd->tree == NULL || sd->lines == NULL || sd->hist == NULL || (max_lines > 0 && sd->heap == NULL)) {
+		perror("Failed to allocate stack distance analyzer");
+		stack_distance_free(sd);
+		return NULL;
+	}
+
+	return sd;
+}
+
+
+void stack_distance_free(struct stack_distance *sd) {
+	if (sd == NULL) return;
+
+	free(sd->tree);
+	free(sd->lines);
+	free(sd->hist);
+	free(sd->heap);
+	free(sd);
+}
+
+
+void stack_distance_access(struct stack_distance *sd, unsigned long mem_addr) {
+	unsigned long block = mem_addr / CACHE_BLOCK_SIZE;
+	struct sd_entry *e;
+
+	if (sd == NULL) return;
+	sd->total_accesses++;
+	if (sd_sample_hash(block) >= sd->threshold) return;
+	sd->num_accesses++;
+	sd->weight_accesses++;
+
+	if (sd->num_lines * 2 >= sd->lines_size && sd_grow_lines(sd) != 0) {
+		fprintf(stderr, "Error: Out of memory in the stack distance analyzer.\n");
+		exit(-1);
+	}
+	if (sd->now == sd->tree_size && sd_compact(sd) != 0) {
+		fprintf(stderr, "Error: Out of memory in the stack distance analyzer.\n");
+		exit(-1);
+	}
+
+	e = sd_lookup(sd, block);
+	if (e->block == 0) {
+		// First touch of this line: a cold miss for every cache size
+		sd->num_cold++;
+		sd->weight_cold++;
+		sd->num_lines++;
+		e->block = block + 1;
+		if (sd->max_lines > 0) heap_push(sd, block);
+	} else {
+		// Distinct lines accessed since this line's previous access
+		unsigned long d = fenwick_sum(sd, sd->now) - fenwick_sum(sd, e->time);
+
+		if (d >= sd->hist_size) {
+			unsigned long size = sd->hist_size;
+			double *hist;
+
+			while (size <= d) size *= 2;
+			hist = (double *)realloc(sd->hist, size * sizeof(double));
+			if (hist == NULL) {
+				fprintf(stderr, "Error: Out of memory in the stack distance analyzer.\n");
+				exit(-1);
+			}
+			memset(hist + sd->hist_size, 0, (size - sd->hist_size) * sizeof(double));
+			sd->hist = hist;
+			sd->hist_size = size;
+		}
+		sd->hist[d]++;
+		fenwick_add(sd, e->time, -1);
+	}
+	e->time = ++sd->now;
+	fenwick_add(sd, e->time, 1);
+
+	if (sd->max_lines > 0 && sd->num_lines > sd->max_lines) sd_lower_threshold(sd);
+}
+
+
+double stack_distance_miss_ratio(struct stack_distance *sd, unsigned long num_lines) {
+	double rate, misses, total;
+	unsigned long first;
+
+	if (sd == NULL || sd->num_accesses == 0) return 0.0;
+
+	// Everything at a distance of num_lines or more was evicted before it was reused. With
+	// sampling, that is a distance of num_lines * rate among the sampled lines.
+	rate = (double)sd->threshold / SD_HASH_SPACE;
+	first = (unsigned long)(num_lines * rate);
+	if ((double)first < num_lines * rate) first++;
+	misses = sd->weight_cold;
+	for (unsigned long d = first; d < sd->hist_size; d++) misses += sd->hist[d];
+
+	/*
+	 * SHARDS-adj: with fixed-rate sampling, the difference between the expected and actual
+	 * number of sampled accesses is credited to the shortest distance (hits for every size).
+	 */
+	total = sd->weight_accesses;
+	if (sd->max_lines == 0 && num_lines > 0) total = sd->total_accesses * rate;
+	if (total <= 0.0) return 0.0;
+	if (misses > total) return 1.0;
+
+	return misses / total;
+}
+
+
+void stack_distance_stats_reset(struct stack_distance *sd) {
+	if (sd == NULL) return;
+	memset(sd->hist, 0, sd->hist_size * sizeof(double));
+	sd->num_accesses = sd->num_cold = sd->total_accesses = 0;
+	sd->weight_accesses = sd->weight_cold = 0.0;
+}
+
+
+void stack_distance_print(struct stack_distance *sd) {
+	unsigned long max_d = 0, lines;
+	double rate;
+
+	if (sd == NULL) return;
+	rate = (double)sd->threshold / SD_HASH_SPACE;
+	for (unsigned long d = 0; d < sd->hist_size; d++) {
+		if (sd->hist[d] != 0) max_d = d;
+	}
+	// The largest distance among all lines that the sampled one stands for
+	max_d = (unsigned long)(max_d / rate);
+
+	printf("Miss Ratio Curve (fully-associative LRU, %d-byte lines):\n", CACHE_BLOCK_SIZE);
+	if (rate < 1.0) {
+		printf("Sampled (SHARDS, %s): Rate: %.6f, Sampled Accesses: %lu of %lu, Sampled Lines: %lu\n",
+		       sd->max_lines > 0 ? "fixed-size" : "fixed-rate", rate,
+		       sd->num_accesses, sd->total_accesses, sd->num_lines);
+	}
+	// Sampled counts are scaled up to all lines, at the final rate the cold misses were rescaled to
+	if (rate < 1.0) {
+		printf("Estimated: Accesses: %lu, Distinct Lines: %.0f, Cold Misses: %.0f\n", sd->total_accesses,
+		       sd->num_lines / rate, sd->weight_cold / rate);
+	} else {
+		printf("Accesses: %lu, Distinct Lines: %lu, Cold Misses: %lu\n", sd->num_accesses, sd->num_lines, sd->num_cold);
+	}
+	printf("%10s %12s %12s\n", "Lines", "Bytes", "Miss Ratio");
+	for (lines = 1; ; lines *= 2) {
+		printf("%10lu %12lu %11.2f%%\n", lines, lines * CACHE_BLOCK_SIZE, stack_distance_miss_ratio(sd, lines) * 100.0);
+		if (lines > max_d) break;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+/*
+ * One-pass Mattson stack-distance analysis. For every access we compute the number of
+ * distinct cache lines touched since the previous access to the same line (its LRU stack
+ * distance). A fully-associative LRU cache of N lines hits exactly the accesses with a
+ * distance below N, so the histogram of distances gives the miss ratio of every cache size
+ * at once. Each access costs O(log n) using a Fenwick tree over access times, and the
+ * analysis can be restricted to a sample of the lines for very long runs.
+ */
+
+/* Define this as you'd like in your .c file. */
+struct stack_distance;
+
+struct stack_distance *stack_distance_alloc(void);
+
+/*
+ * Allocate an analyzer that estimates the curve from a spatially hashed sample of the
+ * cache lines (SHARDS). Every access to a sampled line is tracked, and none to the others.
+ *
+ * @param rate The fraction of lines to sample, in (0, 1]. 1 gives the exact analysis.
+ * @param max_lines If non-zero, the most lines tracked at once (fixed-size SHARDS): the
+ *        rate is lowered as needed to stay within it, which bounds the memory used.
+ */
+struct stack_distance *stack_distance_alloc_sampled(double rate, unsigned long max_lines);
+void stack_distance_free(struct stack_distance *sd);
+
+/*
+ * Record one memory access.
+ *
+ * @param sd The analyzer.
+ * @param mem_addr The memory address accessed, it is reduced to its cache line.
+ */
+void stack_distance_access(struct stack_distance *sd, unsigned long mem_addr);
+
+/*
+ * The miss ratio of a fully-associative LRU cache with `num_lines` lines, over all of the
+ * accesses recorded so far (an estimate when sampling).
+ */
+double stack_distance_miss_ratio(struct stack_distance *sd, unsigned long num_lines);
+
+/*
+ * Zero the histogram and the access counts, keeping the LRU stack: the curve from now on is
+ * that of a warm cache, and lines seen before are no longer cold misses.
+ */
+void stack_distance_stats_reset(struct stack_distance *sd);
+
+/*
+ * Print the miss-ratio curve for power-of-two cache sizes, from a single line up to the
+ * size at which only cold misses remain.
+ */
+void stack_distance_print(struct stack_distance *sd);
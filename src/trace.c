@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+#ifdef TRACE_ZLIB
+#include <zlib.h>
+#endif
+
+#define TRACE_MAGIC "R5TRACE\x01"
+#define TRACE_MAGIC_SZ 8
+// Raw bytes per block; a record takes at most 1 + 3 * 10 bytes
+#define TRACE_BLOCK_SZ (64 * 1024)
+#define TRACE_RECORD_MAX 31
+// Record header bits
+#define TRACE_HDR_STORE 0x4
+#define TRACE_HDR_CORE  0x8
+
+struct trace_writer {
+	FILE *f;
+	int compress;
+	unsigned char buf[TRACE_BLOCK_SZ];
+	unsigned long len;             // Bytes used in buf
+	unsigned long prev_pc, prev_addr;
+	unsigned int prev_core;
+	unsigned long num_records;
+};
+
+struct trace_reader {
+	FILE *f;
+	unsigned int flags;
+	unsigned char buf[TRACE_BLOCK_SZ];
+	unsigned long len, off;        // Bytes in the current block, and how many were decoded
+	unsigned long prev_pc, prev_addr;
+	unsigned int prev_core;
+	int text;                      // A text trace, read line by line
+	unsigned long line;            // Line number in a text trace, for errors
+};
+
+
+static void put_u32(unsigned char *p, unsigned int v) {
+	p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static unsigned int get_u32(unsigned char *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+// Encode a signed delta so that small magnitudes, either way, become small varints
+static inline unsigned long zigzag(unsigned long delta) {
+	return (delta << 1) ^ (unsigned long)((long)delta >> 63);
+}
+
+static inline unsigned long unzigzag(unsigned long v) {
+	return (v >> 1) ^ -(v & 1);
+}
+
+static inline unsigned long put_varint(unsigned char *p, unsigned long v) {
+	unsigned long n = 0;
+
+	while (v >= 0x80) {
+		p[n++] = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	p[n++] = (unsigned char)v;
+	return n;
+}
+
+// Decode a varint, returns the number of bytes used or 0 if it runs past `end`
+static inline unsigned long get_varint(unsigned char *p, unsigned char *end, unsigned long *v) {
+	unsigned long n = 0, shift = 0;
+
+	*v = 0;
+	while (p + n < end && shift < 64) {
+		unsigned char b = p[n++];
+
+		*v |= (unsigned long)(b & 0x7f) << shift;
+		if (!(b & 0x80)) return n;
+		shift += 7;
+	}
+	return 0;
+}
+
+
+struct trace_writer *trace_writer_open(const char *path, int compress) {
+	unsigned char hdr[TRACE_MAGIC_SZ + 4];
+	struct trace_writer *w;
+
+#ifndef TRACE_ZLIB
+	if (compress) {
+		fprintf(stderr, "Error: Trace compression needs a build with zlib.\n");
+		return NULL;
+	}
+#endif
+	w = (struct trace_writer *)calloc(1, sizeof(struct trace_writer));
+	if (w == NULL) {
+		perror("Failed to allocate trace writer");
+		return NULL;
+	}
+	w->f = fopen(path, "wb");
+	if (w->f == NULL) {
+		perror("Failed to create trace file");
+		free(w);
+		return NULL;
+	}
+	w->compress = compress;
+
+	memcpy(hdr, TRACE_MAGIC, TRACE_MAGIC_SZ);
+	put_u32(hdr + TRACE_MAGIC_SZ, compress ? TRACE_FLAG_COMPRESSED : 0);
+	if (fwrite(hdr, sizeof(hdr), 1, w->f) != 1) {
+		perror("Failed to write trace header");
+		fclose(w->f);
+		free(w);
+		return NULL;
+	}
+
+	return w;
+}
+
+
+// Write out the buffered records as one block, and restart the deltas
+static int trace_flush(struct trace_writer *w) {
+	unsigned char hdr[8];
+	unsigned char *data = w->buf;
+	unsigned long stored = w->len;
+
+	if (w->len == 0) return 0;
+#ifdef TRACE_ZLIB
+	unsigned char zbuf[TRACE_BLOCK_SZ + TRACE_BLOCK_SZ / 100 + 64];
+	uLongf zlen = sizeof(zbuf);
+
+	if (w->compress) {
+		if (compress2(zbuf, &zlen, w->buf, w->len, Z_BEST_SPEED) != Z_OK) {
+			fprintf(stderr, "Error: Failed to compress a trace block.\n");
+			return -1;
+		}
+		data = zbuf;
+		stored = zlen;
+	}
+#endif
+	put_u32(hdr, w->len);
+	put_u32(hdr + 4, stored);
+	if (fwrite(hdr, sizeof(hdr), 1, w->f) != 1 || fwrite(data, stored, 1, w->f) != 1) {
+		perror("Failed to write trace block");
+		return -1;
+	}
+	w->len = 0;
+	w->prev_pc = w->prev_addr = 0;
+	w->prev_core = 0;
+
+	return 0;
+}
+
+
+int trace_write(struct trace_writer *w, struct trace_record *r) {
+	unsigned char *p;
+
+	if (w == NULL) return -1;
+	if (w->len + TRACE_RECORD_MAX > TRACE_BLOCK_SZ && trace_flush(w) != 0) return -1;
+
+	p = w->buf + w->len;
+	*p++ = (unsigned char)((__builtin_ctz(r->size) & 0x3) | (r->is_store ? TRACE_HDR_STORE : 0) |
+			       (r->core != w->prev_core ? TRACE_HDR_CORE : 0));
+	if (r->core != w->prev_core) p += put_varint(p, r->core);
+	p += put_varint(p, zigzag(r->pc - w->prev_pc));
+	p += put_varint(p, zigzag(r->addr - w->prev_addr));
+	w->len = p - w->buf;
+	w->prev_pc = r->pc;
+	w->prev_addr = r->addr;
+	w->prev_core = r->core;
+	w->num_records++;
+
+	return 0;
+}
+
+
+unsigned long trace_writer_close(struct trace_writer *w) {
+	unsigned long n;
+
+	if (w == NULL) return 0;
+	trace_flush(w);
+	fclose(w->f);
+	n = w->num_records;
+	free(w);
+
+	return n;
+}
+
+
+struct trace_reader *trace_reader_open(const char *path) {
+	unsigned char hdr[TRACE_MAGIC_SZ + 4];
+	struct trace_reader *r = (struct trace_reader *)calloc(1, sizeof(struct trace_reader));
+
+	if (r == NULL) {
+		perror("Failed to allocate trace reader");
+		return NULL;
+	}
+	r->f = fopen(path, "rb");
+	if (r->f == NULL) {
+		perror("Failed to open trace file");
+		free(r);
+		return NULL;
+	}
+	if (fread(hdr, sizeof(hdr), 1, r->f) != 1 || memcmp(hdr, TRACE_MAGIC, TRACE_MAGIC_SZ) != 0) {
+		// Not a binary trace, read it as text from the start
+		rewind(r->f);
+		r->text = 1;
+		return r;
+	}
+	r->flags = get_u32(hdr + TRACE_MAGIC_SZ);
+#ifndef TRACE_ZLIB
+	if (r->flags & TRACE_FLAG_COMPRESSED) {
+		fprintf(stderr, "Error: %s is compressed, which needs a build with zlib.\n", path);
+		trace_reader_close(r);
+		return NULL;
+	}
+#endif
+
+	return r;
+}
+
+
+// Load the next block, returns 1 on success, 0 at the end of the file, and -1 on error
+static int trace_next_block(struct trace_reader *r) {
+	unsigned char hdr[8];
+	unsigned long raw, stored;
+	size_t n = fread(hdr, 1, sizeof(hdr), r->f);
+
+	if (n == 0 && feof(r->f)) return 0;
+	if (n != sizeof(hdr)) goto corrupt;
+	raw = get_u32(hdr);
+	stored = get_u32(hdr + 4);
+	if (raw > TRACE_BLOCK_SZ) goto corrupt;
+
+	if (r->flags & TRACE_FLAG_COMPRESSED) {
+#ifdef TRACE_ZLIB
+		unsigned char zbuf[TRACE_BLOCK_SZ + TRACE_BLOCK_SZ / 100 + 64];
+		uLongf len = TRACE_BLOCK_SZ;
+
+		if (stored > sizeof(zbuf) || fread(zbuf, stored, 1, r->f) != 1) goto corrupt;
+		if (uncompress(r->buf, &len, zbuf, stored) != Z_OK || len != raw) goto corrupt;
+#endif
+	} else {
+		if (stored != raw || fread(r->buf, raw, 1, r->f) != 1) goto corrupt;
+	}
+	r->len = raw;
+	r->off = 0;
+	r->prev_pc = r->prev_addr = 0;
+	r->prev_core = 0;
+
+	return 1;
+corrupt:
+	fprintf(stderr, "Error: Corrupt trace block.\n");
+	return -1;
+}
+
+
+// Read the next access of a text trace, same return values as `trace_read`
+static int trace_read_text(struct trace_reader *r, struct trace_record *rec) {
+	char line[256], *p, *end;
+	unsigned long v;
+
+	while (fgets(line, sizeof(line), r->f) != NULL) {
+		r->line++;
+		if ((p = strchr(line, '#')) != NULL) *p = '\0';
+		p = line;
+		while (*p == ' ' || *p == '\t') p++;
+		if (*p == '\n' || *p == '\r' || *p == '\0') continue;
+
+		*rec = (struct trace_record){ .size = 8 };
+		rec->core = strtoul(p, &end, 0);
+		if (end == p) goto corrupt;
+		p = end + strspn(end, " \t");
+		if (*p != 'R' && *p != 'r' && *p != 'W' && *p != 'w') goto corrupt;
+		rec->is_store = *p == 'W' || *p == 'w';
+		p++;
+		rec->addr = strtoul(p, &end, 0);
+		if (end == p) goto corrupt;
+		p = end;
+		v = strtoul(p, &end, 0);
+		if (end != p) {
+			if (v != 1 && v != 2 && v != 4 && v != 8) goto corrupt;
+			rec->size = v;
+			p = end;
+			rec->pc = strtoul(p, &end, 0);
+		}
+		return 1;
+	}
+	return ferror(r->f) ? -1 : 0;
+corrupt:
+	fprintf(stderr, "Error: Invalid trace line %lu, expected <core> <R|W> <address> [<size> [<pc>]].\n", r->line);
+	return -1;
+}
+
+
+int trace_read(struct trace_reader *r, struct trace_record *rec) {
+	unsigned long n, v;
+	unsigned char *p, *end;
+	unsigned char hdr;
+
+	if (r == NULL) return -1;
+	if (r->text) return trace_read_text(r, rec);
+	while (r->off == r->len) {
+		int ret = trace_next_block(r);
+
+		if (ret <= 0) return ret;
+	}
+
+	p = r->buf + r->off;
+	end = r->buf + r->len;
+	hdr = *p++;
+	if (hdr & TRACE_HDR_CORE) {
+		if ((n = get_varint(p, end, &v)) == 0) goto corrupt;
+		p += n;
+		r->prev_core = v;
+	}
+	if ((n = get_varint(p, end, &v)) == 0) goto corrupt;
+	p += n;
+	r->prev_pc += unzigzag(v);
+	if ((n = get_varint(p, end, &v)) == 0) goto corrupt;
+	p += n;
+	r->prev_addr += unzigzag(v);
+	r->off = p - r->buf;
+
+	rec->pc = r->prev_pc;
+	rec->addr = r->prev_addr;
+	rec->size = 1u << (hdr & 0x3);
+	rec->is_store = !!(hdr & TRACE_HDR_STORE);
+	rec->core = r->prev_core;
+
+	return 1;
+corrupt:
+	fprintf(stderr, "Error: Corrupt trace record.\n");
+	return -1;
+}
+
+
+void trace_reader_close(struct trace_reader *r) {
+	if (r == NULL) return;
+	if (r->f) fclose(r->f);
+	free(r);
+}
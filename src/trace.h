@@ -0,0 +1,52 @@
+#pragma once
+
+/*
+ * Memory-access traces: the stream of loads and stores the emulator performs, recorded so
+ * that cache experiments can be replayed (`--trace-in`) without executing the program.
+ *
+ * File format: an 8-byte magic ("R5TRACE" and a version byte), a 4-byte flags word, then
+ * blocks. Each block has a 4-byte raw length, a 4-byte stored length, and the stored bytes,
+ * which are deflate-compressed when TRACE_FLAG_COMPRESSED is set. Inside a block, each
+ * record is a header byte (log2 of the access size in bits 0-1, bit 2 set for stores, bit 3
+ * set when the core differs from the previous record's) followed, if bit 3 is set, by the
+ * varint core number, and then by the zigzag varint deltas of the pc and the address from
+ * the previous record. The deltas and the core restart from zero at every block, so blocks
+ * can be decoded independently.
+ *
+ * Traces from other tools (e.g. of multi-threaded programs) can be replayed as text instead:
+ * one access per line, "<core> <R|W> <address> [<size> [<pc>]]", with the numbers in decimal
+ * or 0x hex, and '#' starting a comment. The size defaults to 8 and the pc to 0.
+ */
+
+#define TRACE_FLAG_COMPRESSED 0x1
+
+struct trace_record {
+	unsigned long pc;   // Address of the load/store
+	unsigned long addr; // Memory address accessed
+	unsigned int size;  // 1, 2, 4 or 8 bytes
+	int is_store;
+	unsigned int core; // Core (hart) that made the access, 0 in a single-core run
+};
+
+/* Define these as you'd like in your .c file. */
+struct trace_writer;
+struct trace_reader;
+
+/*
+ * Create a trace file.
+ *
+ * @param path The file to write.
+ * @param compress Non-zero to deflate each block (only if built with zlib).
+ * @return The writer, or NULL on error.
+ */
+struct trace_writer *trace_writer_open(const char *path, int compress);
+/* Append a record, returns 0 on success and -1 on error */
+int trace_write(struct trace_writer *w, struct trace_record *r);
+/* Flush the last block, and close the file. Returns the number of records written. */
+unsigned long trace_writer_close(struct trace_writer *w);
+
+/* Open a trace file, binary or text, for reading, NULL on error */
+struct trace_reader *trace_reader_open(const char *path);
+/* Read the next record: returns 1 if one was read, 0 at the end of the trace, and -1 on error */
+int trace_read(struct trace_reader *r, struct trace_record *rec);
+void trace_reader_close(struct trace_reader *r);
@@ -1,4 +1,5 @@
 #include <processor.h>
+#include <prefetch.h>
 
 #include <string.h>
 #include <stdlib.h>
@@ -181,6 +182,88 @@ instr_name(enum instruction_num n)
 	return NULL;
 }
 
+/*
+ * The class of an instruction (see `enum instr_class`).
+ */
+enum instr_class
+instr_class(enum instruction_num n)
+{
+	switch (n) {
+	case ECALL:
+		return CLASS_SYSTEM;
+	case SB: case SH: case SW: case SD:
+		return CLASS_STORE;
+	case LB: case LH: case LW: case LBU: case LHU: case LWU: case LD:
+		return CLASS_LOAD;
+	case BEQ: case BNE: case BLT: case BGE: case BLTU: case BGEU:
+		return CLASS_BRANCH;
+	case JAL: case JALR:
+		return CLASS_JUMP;
+	default:
+		return CLASS_ALU;
+	}
+}
+
+char *
+instr_class_name(enum instr_class c)
+{
+	char *names[] = {
+		[CLASS_ALU]    = "alu",
+		[CLASS_LOAD]   = "load",
+		[CLASS_STORE]  = "store",
+		[CLASS_BRANCH] = "branch",
+		[CLASS_JUMP]   = "jump",
+		[CLASS_SYSTEM] = "system",
+	};
+
+	assert(c < CLASS_COUNT);
+	return names[c];
+}
+
+/*
+ * The registers an instruction writes (`rd`) and reads (`rs1`, `rs2`),
+ * 0 (x0, which never creates a dependency) where it has none. Timing
+ * models use this to find the dependencies between instructions.
+ */
+void
+instr_regs(struct instruction *i, unsigned int *rd, unsigned int *rs1, unsigned int *rs2)
+{
+	*rd = *rs1 = *rs2 = 0;
+	switch (i->fmt_type) {
+	case FMT_RRR:
+		*rd  = i->format.rrr.rd;
+		*rs1 = i->format.rrr.rs1;
+		*rs2 = i->format.rrr.rs2;
+		break;
+	case FMT_RRI:
+		/* Branches compare their two registers, and write none */
+		if (instr_class(i->inst_no) == CLASS_BRANCH) {
+			*rs1 = i->format.rri.rd;
+			*rs2 = i->format.rri.rs1;
+		} else {
+			*rd  = i->format.rri.rd;
+			*rs1 = i->format.rri.rs1;
+		}
+		break;
+	case FMT_ROR:
+		/* Base register, and the value stored or the register loaded/linked */
+		*rs1 = i->format.ror.r1;
+		if (instr_class(i->inst_no) == CLASS_STORE) *rs2 = i->format.ror.r2;
+		else                                        *rd  = i->format.ror.r2;
+		break;
+	case FMT_RI:
+		*rd = i->format.ri.rd;
+		break;
+	case FMT_ECALL:
+		/* The syscall number (a7) and its argument (a0) */
+		*rs1 = 17;
+		*rs2 = 10;
+		break;
+	case FMT_ERROR:
+		break;
+	}
+}
+
 /*
  * Another useful function to return the instruction number (or
  * `INSTRINVALID` on error) from the string of its instruction name.
@@ -298,16 +381,23 @@ stringify_program(struct instructions *p)
 	return o;
 }
 
+/*
+ * This will store the registers from the previous time
+ * `processor_registers_print` was called, or they were synced.
+ */
+static unsigned long prev_rs[32] = { 0 };
+
+void
+processor_registers_sync(struct processor *p)
+{
+	int i;
+
+	for (i = 0; i < 32; i++) prev_rs[i] = registers_getreg(p->rs, i);
+}
+
 void
 processor_registers_print(struct processor *p)
 {
-	/*
-	 * This will store the registers from the previous time this
-	 * was called. Recall that `static` variables in a function
-	 * are effectively global (thus persist across calls to this
-	 * function), without being accessible from other functions.
-	 */
-	static unsigned long prev_rs[32] = { 0 };
 	int i;
 
 	printf("pc: 0x%x, ", registers_getpc(p->rs));
@@ -356,6 +446,32 @@ processor_memory_print(struct processor *p)
 	printf("\n");
 }
 
+/*
+ * Print the loads/stores with the most cache misses, disassembled when
+ * the program is known (not when replaying a trace).
+ */
+static void
+processor_pc_stats_print(struct processor *p)
+{
+	struct pc_stat *top = malloc(p->cfg.pc_stats * sizeof(struct pc_stat));
+	unsigned long i, n;
+
+	assert(top);
+	n = pc_stats_top(p->pc_stats, top, p->cfg.pc_stats);
+	printf("Top %lu Instructions by Cache Misses:\n", n);
+	printf("%14s %14s %10s  %s\n", "Accesses", "Misses", "Miss Rate", "Instruction");
+	for (i = 0; i < n; i++) {
+		printf("%14lu %14lu %9.2f%%  ", top[i].accesses, top[i].misses,
+			((double)top[i].misses / (double)top[i].accesses) * 100.0);
+		if (p->instrs && top[i].pc >= p->cfg.instr_lower && top[i].pc < p->cfg.instr_upper) {
+			instruction_print(&p->instrs->instructions[(top[i].pc - p->cfg.instr_lower) / 4]);
+		} else {
+			printf("0x%lx\n", top[i].pc);
+		}
+	}
+	free(top);
+}
+
 void
 processor_cache_print(struct processor *p)
 {
@@ -371,6 +487,43 @@ processor_cache_print(struct processor *p)
 	printf("Cache Hit Rate: %.2f%%\n", 
 		s.num_cache_accesses == 0 ? 0.0 : 
 		(((double)s.num_cache_accesses - (double)s.num_cache_misses) / (double)s.num_cache_accesses) * 100.0);
+	if (p->cfg.victim_entries > 0) {
+		printf("%s: %lu entries, Hits: %lu, Misses Without It: %lu\n",
+			p->cfg.victim_mode == VICTIM_CACHE ? "Victim Cache" : "Miss Cache",
+			p->cfg.victim_entries, s.num_victim_hits, s.num_cache_misses + s.num_victim_hits);
+	}
+	if (p->cfg.prefetch_type != PREFETCH_NONE) {
+		printf("Prefetcher: %s, Degree: %lu, Distance: %lu, Latency: %lu\n",
+			prefetch_type_name(p->cfg.prefetch_type), p->cfg.prefetch_degree,
+			p->cfg.prefetch_distance, p->cfg.prefetch_latency);
+		printf("Prefetches Issued: %lu, Useful: %lu, Late: %lu, Polluting: %lu\n",
+			s.num_prefetches, s.num_prefetch_useful, s.num_prefetch_late, s.num_prefetch_polluting);
+		printf("Prefetch Accuracy: %.2f%%\n",
+			s.num_prefetches == 0 ? 0.0 : ((double)s.num_prefetch_useful / (double)s.num_prefetches) * 100.0);
+	}
+	if (p->num_caches > 1) {
+		unsigned long i;
+
+		printf("Cache Configurations:\n");
+		printf("%10s %10s %6s %14s %14s %10s\n", "Lines", "Sets", "Ways", "Accesses", "Misses", "Hit Rate");
+		for (i = 0; i < p->num_caches; i++) {
+			struct cache_stats cs = cache_statistics(p->caches[i]);
+
+			printf("%10lu %10lu %6lu %14lu %14lu %9.2f%%\n",
+				p->cfg.cache_config_lines[i], p->cfg.cache_config_sets[i],
+				p->cfg.cache_config_lines[i] / p->cfg.cache_config_sets[i],
+				cs.num_cache_accesses, cs.num_cache_misses,
+				cs.num_cache_accesses == 0 ? 0.0 :
+				(((double)cs.num_cache_accesses - (double)cs.num_cache_misses) / (double)cs.num_cache_accesses) * 100.0);
+		}
+	}
+	if (p->pc_stats) processor_pc_stats_print(p);
+	if (p->regions) regions_print(p->regions);
+	if (p->sd) stack_distance_print(p->sd);
+	if (p->coherence) coherence_print(p->coherence);
+	if (p->dram) dram_print(p->dram);
+	if (p->vm) vm_print(p->vm, p->num_instrs - p->reset_instrs);
+	if (p->loopnest) loopnest_print(p->loopnest);
 }
 
 void
@@ -386,7 +539,12 @@ processor_print_exception(struct processor *p, enum exception e)
 	assert(e <= EXCEPTION_UNKNOWN_SYSCALL);
 	printf("%s, register state:\n", exception_name[e]);
 	processor_registers_printall(p);
+	processor_models_sync(p);
 	if (p->cfg.print_cache) processor_cache_print(p);
+	if (p->pipeline) pipeline_print(p->pipeline);
+	if (p->ooo) ooo_print(p->ooo);
+	if (p->bpred) bpred_print(p->bpred, p->num_instrs - p->reset_instrs);
+	if (p->ilp) ilp_print(p->ilp);
 
 	return;
 }
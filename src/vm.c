@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm.h"
+
+// Sv39: 39-bit virtual addresses, 9 bits of virtual page number per level, 8-byte entries
+#define VM_VA_BITS    39
+#define VM_PAGE_SHIFT 12
+#define VM_LEVEL_BITS 9
+#define VM_PTE_SIZE   8
+#define VM_TABLE_SIZE (1UL << VM_PAGE_SHIFT)
+
+struct tlb_entry {
+	unsigned long vpn;
+	unsigned long used; // Last lookup that hit or filled it, for LRU
+	int valid;
+};
+
+struct tlb {
+	const char *name;
+	unsigned long num_entries, num_ways, num_sets;
+	struct tlb_entry *entries;
+	unsigned long num_accesses, num_misses;
+};
+
+struct vm {
+	struct vm_config cfg;
+	struct cache *cache;
+	unsigned long page_shift;
+	struct tlb itlb, dtlb, l2tlb;
+	unsigned long clock;
+	// Physical address of the root table, and of the tables below it, by the virtual
+	// address bits above what each maps (only 2 MiB pages have no last level)
+	unsigned long root, *mid_tables, *leaf_tables;
+	unsigned long num_tables, num_pages;
+	unsigned long num_walks, num_pte_reads, num_pte_misses, walk_cycles, cycles;
+};
+
+
+static int tlb_init(struct tlb *t, const char *name, unsigned long num_entries, unsigned long num_ways) {
+	if (num_ways == 0 || num_entries == 0 || num_entries % num_ways != 0) {
+		fprintf(stderr, "Error: The %s needs a number of entries that is a multiple of its ways.\n", name);
+		return -1;
+	}
+	t->name = name;
+	t->num_entries = num_entries;
+	t->num_ways = num_ways;
+	t->num_sets = num_entries / num_ways;
+	t->entries = (struct tlb_entry *)calloc(num_entries, sizeof(struct tlb_entry));
+	if (t->entries == NULL) {
+		perror("Failed to allocate TLB");
+		return -1;
+	}
+	return 0;
+}
+
+
+// Look up a page, filling it in on a miss, returns 1 on a hit
+static int tlb_lookup(struct tlb *t, unsigned long vpn, unsigned long clock) {
+	struct tlb_entry *set = &t->entries[(vpn % t->num_sets) * t->num_ways], *victim = set;
+
+	t->num_accesses++;
+	for (unsigned long w = 0; w < t->num_ways; w++) {
+		if (set[w].valid && set[w].vpn == vpn) {
+			set[w].used = clock;
+			return 1;
+		}
+		if (!set[w].valid || (victim->valid && set[w].used < victim->used)) victim = &set[w];
+	}
+	t->num_misses++;
+	*victim = (struct tlb_entry){ .vpn = vpn, .used = clock, .valid = 1 };
+	return 0;
+}
+
+
+int vm_page_size_parse(const char *name) {
+	if (strcmp(name, "4k") == 0) return VM_PAGE_4K;
+	if (strcmp(name, "2m") == 0) return VM_PAGE_2M;
+	return -1;
+}
+
+
+struct vm *vm_alloc(struct vm_config *cfg, struct cache *cache) {
+	struct vm *v;
+	unsigned long table = 0, num_mid, num_leaf;
+
+	if (cfg->upper <= cfg->lower || cfg->upper > (1UL << (VM_VA_BITS - 1))) {
+		fprintf(stderr, "Error: The image does not fit in the Sv39 address space.\n");
+		return NULL;
+	}
+	v = (struct vm *)calloc(1, sizeof(struct vm));
+	if (v == NULL) {
+		perror("Failed to allocate virtual memory");
+		return NULL;
+	}
+	v->cfg = *cfg;
+	v->cache = cache;
+	v->page_shift = cfg->page_size == VM_PAGE_2M ? VM_PAGE_SHIFT + VM_LEVEL_BITS : VM_PAGE_SHIFT;
+	if (tlb_init(&v->itlb, "ITLB", cfg->itlb_entries, cfg->itlb_ways) ||
+	    tlb_init(&v->dtlb, "DTLB", cfg->dtlb_entries, cfg->dtlb_ways) ||
+	    tlb_init(&v->l2tlb, "L2 TLB", cfg->l2tlb_entries, cfg->l2tlb_ways)) {
+		vm_free(v);
+		return NULL;
+	}
+
+	// Lay out the tables page by page above the image: the root, then one table per 1 GiB
+	// of the image, then, for 4 KiB pages, one per 2 MiB
+	num_mid = ((cfg->upper - 1) >> 30) - (cfg->lower >> 30) + 1;
+	num_leaf = cfg->page_size == VM_PAGE_4K ? ((cfg->upper - 1) >> 21) - (cfg->lower >> 21) + 1 : 0;
+	v->mid_tables = (unsigned long *)calloc(num_mid, sizeof(unsigned long));
+	v->leaf_tables = (unsigned long *)calloc(num_leaf ? num_leaf : 1, sizeof(unsigned long));
+	if (v->mid_tables == NULL || v->leaf_tables == NULL) {
+		perror("Failed to allocate page tables");
+		vm_free(v);
+		return NULL;
+	}
+	v->root = (cfg->upper + VM_TABLE_SIZE - 1) & ~(VM_TABLE_SIZE - 1);
+	table = v->root + VM_TABLE_SIZE;
+	for (unsigned long i = 0; i < num_mid; i++, table += VM_TABLE_SIZE) v->mid_tables[i] = table;
+	for (unsigned long i = 0; i < num_leaf; i++, table += VM_TABLE_SIZE) v->leaf_tables[i] = table;
+	v->num_tables = 1 + num_mid + num_leaf;
+	v->num_pages = ((cfg->upper - 1) >> v->page_shift) - (cfg->lower >> v->page_shift) + 1;
+
+	return v;
+}
+
+
+void vm_free(struct vm *v) {
+	if (v == NULL) return;
+	free(v->itlb.entries);
+	free(v->dtlb.entries);
+	free(v->l2tlb.entries);
+	free(v->mid_tables);
+	free(v->leaf_tables);
+	free(v);
+}
+
+
+// Read one page-table entry through the cache, returns its latency
+static unsigned long pte_read(struct vm *v, unsigned long pte) {
+	v->num_pte_reads++;
+	if (cache_access_pc(v->cache, 0, pte) == 1) return v->cfg.hit_latency;
+	v->num_pte_misses++;
+	return v->cfg.miss_latency;
+}
+
+
+// Walk the page tables for an address, returns the cycles it took
+static unsigned long walk(struct vm *v, unsigned long addr) {
+	unsigned long vpn2 = (addr >> 30) & 511, vpn1 = (addr >> 21) & 511, vpn0 = (addr >> 12) & 511;
+	unsigned long cycles;
+
+	v->num_walks++;
+	cycles = pte_read(v, v->root + vpn2 * VM_PTE_SIZE);
+	cycles += pte_read(v, v->mid_tables[(addr >> 30) - (v->cfg.lower >> 30)] + vpn1 * VM_PTE_SIZE);
+	if (v->cfg.page_size == VM_PAGE_4K) {
+		cycles += pte_read(v, v->leaf_tables[(addr >> 21) - (v->cfg.lower >> 21)] + vpn0 * VM_PTE_SIZE);
+	}
+	v->walk_cycles += cycles;
+
+	return cycles;
+}
+
+
+static unsigned long translate(struct vm *v, struct tlb *l1, unsigned long addr) {
+	unsigned long vpn = addr >> v->page_shift, cycles;
+
+	if (addr < v->cfg.lower || addr >= v->cfg.upper) return 0;
+	v->clock++;
+	if (tlb_lookup(l1, vpn, v->clock)) return 0;
+	cycles = v->cfg.l2_latency;
+	if (!tlb_lookup(&v->l2tlb, vpn, v->clock)) cycles += walk(v, addr);
+	v->cycles += cycles;
+
+	return cycles;
+}
+
+
+unsigned long vm_fetch(struct vm *v, unsigned long addr) {
+	return translate(v, &v->itlb, addr);
+}
+
+
+unsigned long vm_access(struct vm *v, unsigned long addr) {
+	return translate(v, &v->dtlb, addr);
+}
+
+
+void vm_stats_reset(struct vm *v) {
+	if (v == NULL) return;
+	v->itlb.num_accesses = v->itlb.num_misses = 0;
+	v->dtlb.num_accesses = v->dtlb.num_misses = 0;
+	v->l2tlb.num_accesses = v->l2tlb.num_misses = 0;
+	v->num_walks = v->num_pte_reads = v->num_pte_misses = v->walk_cycles = v->cycles = 0;
+}
+
+
+static void tlb_print(struct vm *v, struct tlb *t, unsigned long num_instrs) {
+	printf("%s: %lu entries, %lu-way, Reach: %lu KiB, Accesses: %lu, Misses: %lu, Miss Rate: %.2f%%, MPKI: %.2f\n",
+		t->name, t->num_entries, t->num_ways, (t->num_entries << v->page_shift) / 1024, t->num_accesses, t->num_misses,
+		t->num_accesses == 0 ? 0.0 : ((double)t->num_misses / (double)t->num_accesses) * 100.0,
+		num_instrs == 0 ? 0.0 : (double)t->num_misses * 1000.0 / (double)num_instrs);
+}
+
+
+void vm_print(struct vm *v, unsigned long num_instrs) {
+	if (v == NULL) return;
+	printf("Virtual Memory: Sv39, %s pages, %lu pages mapped, %lu page-table pages at 0x%lx\n",
+		v->cfg.page_size == VM_PAGE_2M ? "2 MiB" : "4 KiB", v->num_pages, v->num_tables, v->root);
+	tlb_print(v, &v->itlb, num_instrs);
+	tlb_print(v, &v->dtlb, num_instrs);
+	tlb_print(v, &v->l2tlb, num_instrs);
+	printf("Page Walks: %lu, Page-Table Reads: %lu, Cache Misses: %lu, Average Walk: %.2f cycles\n",
+		v->num_walks, v->num_pte_reads, v->num_pte_misses,
+		v->num_walks == 0 ? 0.0 : (double)v->walk_cycles / (double)v->num_walks);
+	printf("Translation Cycles: %lu, per Instruction: %.3f\n",
+		v->cycles, num_instrs == 0 ? 0.0 : (double)v->cycles / (double)num_instrs);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cache.h>
+
+/*
+ * Sv39 virtual memory for the guest image, to measure what address translation costs. The
+ * emulator builds the page tables itself: every page of the image (the instructions and the
+ * data) is mapped to the same physical address, with 4 KiB pages (three-level walks) or
+ * 2 MiB pages (two-level walks), and the tables sit in physical memory right above the image.
+ *
+ * Instruction fetches look up the L1 instruction TLB and loads and stores the L1 data TLB.
+ * Their misses look up the shared L2 TLB, and its misses walk the page tables: each
+ * page-table entry read goes through the cache, like any load, and costs its hit or miss
+ * latency. An L2 TLB hit costs `l2_latency` cycles. All the TLBs are set-associative with LRU
+ * replacement.
+ */
+
+enum vm_page_size {
+	VM_PAGE_4K,
+	VM_PAGE_2M,
+};
+
+struct vm_config {
+	unsigned long lower, upper;                // The image: its lowest address, and one past its highest
+	enum vm_page_size page_size;               // The pages the image is mapped with
+	unsigned long itlb_entries, itlb_ways;     // L1 instruction TLB
+	unsigned long dtlb_entries, dtlb_ways;     // L1 data TLB
+	unsigned long l2tlb_entries, l2tlb_ways;   // Shared L2 TLB
+	unsigned long l2_latency;                  // Cycles for an L2 TLB hit
+	unsigned long hit_latency, miss_latency;   // Cycles for a page-table entry read that hits and misses
+};
+
+/* Define this as you'd like in your .c file. */
+struct vm;
+
+/*
+ * Build the page tables for the image, and empty TLBs.
+ *
+ * @param cfg The image, the page size, and the TLBs.
+ * @param cache The cache the page walks read the page-table entries through.
+ */
+struct vm *vm_alloc(struct vm_config *cfg, struct cache *cache);
+void vm_free(struct vm *v);
+
+/*
+ * Translate the address of an instruction fetch, or of a load or store.
+ *
+ * @param v The virtual memory.
+ * @param addr The virtual address, inside the image.
+ * @return The cycles the translation took beyond an L1 TLB hit.
+ */
+unsigned long vm_fetch(struct vm *v, unsigned long addr);
+unsigned long vm_access(struct vm *v, unsigned long addr);
+
+/* Parse an `enum vm_page_size` ("4k" or "2m"), -1 if unknown */
+int vm_page_size_parse(const char *name);
+
+/* Zero the TLBs' accesses and misses, the page walks and the translation cycles, keeping the TLBs' contents */
+void vm_stats_reset(struct vm *v);
+
+/*
+ * Print the page tables, the TLBs' reach, accesses, misses and misses per thousand
+ * instructions, the page walks, and the cycles spent translating.
+ *
+ * @param v The virtual memory.
+ * @param num_instrs The instructions executed.
+ */
+void vm_print(struct vm *v, unsigned long num_instrs);
@@ -0,0 +1,14 @@
+0:	lui x9,0x1
+8:	addi x10,x0,16
+c:	addi x5,x0,0
+10:	ld x6,0(x9)
+14:	add x7,x7,x6
+18:	ld x28,8(x9)
+1c:	jal x1,34
+20:	addi x9,x9,64
+24:	addi x5,x5,1
+28:	blt x5,x10,10
+2c:	addi x17,x0,2
+30:	ecall
+34:	addi x29,x29,1
+38:	jalr x0,0(x1)
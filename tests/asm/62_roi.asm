@@ -0,0 +1,22 @@
+0:	lui x9,0x1
+8:	addi x10,x0,3
+c:	addi x11,x0,8
+10:	addi x5,x0,0
+14:	sd x10,0(x9)
+18:	addi x17,x0,24
+1c:	ecall
+20:	addi x17,x0,26
+24:	ecall
+28:	addi x6,x0,0
+2c:	add x18,x0,x9
+30:	ld x7,0(x18)
+34:	addi x18,x18,64
+38:	addi x6,x6,1
+3c:	blt x6,x11,30
+40:	addi x5,x5,1
+44:	blt x5,x10,20
+48:	addi x17,x0,25
+4c:	ecall
+50:	ld x28,512(x9)
+54:	addi x17,x0,2
+58:	ecall
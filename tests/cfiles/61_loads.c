@@ -0,0 +1,37 @@
+/*
+ * A short loop for the timing models: each iteration loads a new
+ * cache line, uses the value right away (a load-use hazard), loads
+ * the same line again (a hit) and calls a leaf function (a call and
+ * a return for the BTB and the RAS).
+ */
+
+#define BLOCK_SZ 64
+#define NITERS 16
+
+struct cache_line {
+	long a, b;
+	char padding[BLOCK_SZ - 2 * sizeof(long)];
+} __attribute__((aligned(BLOCK_SZ)));
+
+struct cache_line lines[NITERS];
+volatile long sum, second, calls;
+
+void
+bump(void)
+{
+	calls++;
+}
+
+int
+main(void)
+{
+	int i;
+
+	for (i = 0; i < NITERS; i++) {
+		sum += lines[i].a;
+		second = lines[i].b;
+		bump();
+	}
+
+	return 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * Region of interest markers (ecall 24 begins it, 25 ends it and 26
+ * resets the statistics): a store before the region, a loop over
+ * NLINES cache lines NPASSES times that resets the statistics at the
+ * top of every pass, so only the last (warm) pass is reported, and a
+ * load after the region.
+ */
+
+#define BLOCK_SZ 64
+#define NLINES 8
+#define NPASSES 3
+
+#define ROI_BEGIN 24
+#define ROI_END 25
+#define ROI_RESET 26
+
+struct cache_line {
+	long a;
+	char padding[BLOCK_SZ - sizeof(long)];
+} __attribute__((aligned(BLOCK_SZ)));
+
+struct cache_line lines[NLINES + 1];
+volatile long value;
+
+static void
+roi(long op)
+{
+	register long a7 __asm__("a7") = op;
+
+	__asm__ volatile("ecall" : : "r"(a7) : "memory");
+}
+
+int
+main(void)
+{
+	int i, k;
+
+	lines[0].a = NPASSES;
+
+	roi(ROI_BEGIN);
+	for (k = 0; k < NPASSES; k++) {
+		roi(ROI_RESET);
+		for (i = 0; i < NLINES; i++) {
+			value = lines[i].a;
+		}
+	}
+	roi(ROI_END);
+	value = lines[NLINES].a;
+
+	return 0;
+}